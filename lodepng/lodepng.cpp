@@ -5830,6 +5830,262 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
   return state->error;
 }
 
+#ifdef LODEPNG_COMPILE_ZLIB
+/*filtered bytes deflated per block by the streaming encoder. Like the blocks of lodepng_deflatev,
+big enough that the huffman trees cost little, and small enough to adapt to the image.*/
+static const size_t STREAM_BLOCK_SIZE = 65536;
+
+/*everything but the settings back to how lodepng_stream_init leaves it*/
+static void stream_reset(LodePNGStreamEncoder* stream)
+{
+  stream->write = 0;
+  stream->user = 0;
+  stream->w = stream->h = 0;
+  stream->bytewidth = stream->linebytes = 0;
+  stream->rows = 0;
+  stream->error = 0;
+  stream->adler = 1;
+  stream->prevline = 0;
+  stream->attempt = 0;
+  stream->data = 0;
+  stream->datasize = stream->datapos = stream->dataalloc = 0;
+  stream->deflated = 0;
+  stream->deflatedsize = stream->deflatedalloc = 0;
+  stream->bp = 0;
+  stream->hash = 0;
+}
+
+void lodepng_stream_init(LodePNGStreamEncoder* stream)
+{
+  lodepng_compress_settings_init(&stream->zlibsettings);
+  stream_reset(stream);
+}
+
+void lodepng_stream_cleanup(LodePNGStreamEncoder* stream)
+{
+  lodepng_free(stream->prevline);
+  lodepng_free(stream->attempt);
+  lodepng_free(stream->data);
+  lodepng_free(stream->deflated);
+  if(stream->hash)
+  {
+    hash_cleanup((Hash*)stream->hash);
+    lodepng_free(stream->hash);
+  }
+  stream_reset(stream);
+}
+
+/*hand data to the write callback as one chunk of the given type*/
+static unsigned stream_write_chunk(LodePNGStreamEncoder* stream, const char* type,
+                                   const unsigned char* data, size_t length)
+{
+  unsigned error;
+  unsigned char* chunk = 0;
+  size_t chunksize = 0;
+  error = lodepng_chunk_create(&chunk, &chunksize, (unsigned)length, type, data);
+  if(!error) error = stream->write(stream->user, chunk, chunksize);
+  lodepng_free(chunk);
+  return error;
+}
+
+/*write the whole bytes deflated so far as an IDAT chunk, keeping the last byte if it's only partly filled*/
+static unsigned stream_flush(LodePNGStreamEncoder* stream)
+{
+  size_t whole = stream->bp / 8;
+  unsigned error = 0;
+  if(whole == 0) return 0;
+  error = stream_write_chunk(stream, "IDAT", stream->deflated, whole);
+  if(error) return error;
+  if(stream->deflatedsize > whole) stream->deflated[0] = stream->deflated[whole];
+  stream->deflatedsize -= whole;
+  stream->bp &= 7;
+  return 0;
+}
+
+/*deflate the data not yet deflated as one block, then drop what the LZ77 window no longer needs*/
+static unsigned stream_deflate(LodePNGStreamEncoder* stream, unsigned final)
+{
+  unsigned error = 0;
+  size_t windowsize = stream->zlibsettings.windowsize;
+  size_t drop;
+  ucvector v;
+  v.data = stream->deflated;
+  v.size = stream->deflatedsize;
+  v.allocsize = stream->deflatedalloc;
+
+  if(stream->zlibsettings.btype == 1 || stream->datapos == stream->datasize)
+  {
+    error = deflateFixed(&v, &stream->bp, (Hash*)stream->hash, stream->data,
+                         stream->datapos, stream->datasize, &stream->zlibsettings, final);
+  }
+  else
+  {
+    error = deflateDynamic(&v, &stream->bp, (Hash*)stream->hash, stream->data,
+                           stream->datapos, stream->datasize, &stream->zlibsettings, final);
+  }
+  stream->deflated = v.data;
+  stream->deflatedsize = v.size;
+  stream->deflatedalloc = v.allocsize;
+  if(error) return error;
+  stream->datapos = stream->datasize;
+
+  /*keep the last window. Dropping a multiple of the window size keeps the positions in the hash,
+  which are taken modulo the window size, pointing at the same bytes.*/
+  if(stream->datasize > windowsize)
+  {
+    drop = (stream->datasize - windowsize) / windowsize * windowsize;
+    if(drop)
+    {
+      memmove(stream->data, &stream->data[drop], stream->datasize - drop);
+      stream->datasize -= drop;
+      stream->datapos -= drop;
+    }
+  }
+
+  return stream_flush(stream);
+}
+
+unsigned lodepng_stream_begin(LodePNGStreamEncoder* stream, unsigned w, unsigned h,
+                              LodePNGColorType colortype, LodePNGStreamWrite write, void* user)
+{
+  unsigned error = 0;
+  ucvector header;
+  /*zlib header: the same as lodepng_zlib_compress writes*/
+  unsigned CMFFLG = 256 * 120;
+  CMFFLG += 31 - CMFFLG % 31;
+
+  lodepng_stream_cleanup(stream);
+  if(w == 0 || h == 0) return stream->error = 93;
+  if(colortype != LCT_RGB && colortype != LCT_RGBA) return stream->error = 95;
+  if(stream->zlibsettings.btype != 1 && stream->zlibsettings.btype != 2) return stream->error = 95;
+  if(stream->zlibsettings.windowsize == 0 || stream->zlibsettings.windowsize > 32768) return stream->error = 60;
+  if((stream->zlibsettings.windowsize & (stream->zlibsettings.windowsize - 1)) != 0) return stream->error = 90;
+
+  stream->write = write;
+  stream->user = user;
+  stream->w = w;
+  stream->h = h;
+  stream->bytewidth = colortype == LCT_RGBA ? 4 : 3;
+  stream->linebytes = stream->bytewidth * w;
+
+  stream->prevline = (unsigned char*)lodepng_malloc(stream->linebytes);
+  stream->attempt = (unsigned char*)lodepng_malloc(5 * (stream->linebytes + 1));
+  /*up to two windows kept after a block, then up to a block and a scanline more*/
+  stream->dataalloc = 2 * stream->zlibsettings.windowsize + STREAM_BLOCK_SIZE + stream->linebytes + 1;
+  stream->data = (unsigned char*)lodepng_malloc(stream->dataalloc);
+  stream->hash = lodepng_malloc(sizeof(Hash));
+  if(!stream->prevline || !stream->attempt || !stream->data || !stream->hash)
+  {
+    lodepng_free(stream->hash);
+    stream->hash = 0;
+    return stream->error = 83; /*alloc fail*/
+  }
+  error = hash_init((Hash*)stream->hash, stream->zlibsettings.windowsize);
+  if(error)
+  {
+    hash_cleanup((Hash*)stream->hash);
+    lodepng_free(stream->hash);
+    stream->hash = 0;
+    return stream->error = error;
+  }
+
+  ucvector_init(&header);
+  writeSignature(&header);
+  error = addChunk_IHDR(&header, w, h, colortype, 8, 0);
+  if(!error) error = write(user, header.data, header.size);
+  ucvector_cleanup(&header);
+  if(error) return stream->error = error;
+
+  /*the zlib header goes at the start of the first IDAT*/
+  stream->deflated = (unsigned char*)lodepng_malloc(2);
+  if(!stream->deflated) return stream->error = 83; /*alloc fail*/
+  stream->deflated[0] = (unsigned char)(CMFFLG >> 8);
+  stream->deflated[1] = (unsigned char)(CMFFLG & 255);
+  stream->deflatedsize = stream->deflatedalloc = 2;
+  stream->bp = 16;
+
+  return 0;
+}
+
+unsigned lodepng_stream_add_row(LodePNGStreamEncoder* stream, const unsigned char* scanline)
+{
+  size_t linebytes = stream->linebytes;
+  size_t smallest = 0, sum, x;
+  unsigned char type, bestType = 0;
+  unsigned char* best;
+
+  if(stream->error) return stream->error;
+  if(!stream->data || stream->rows == stream->h) return stream->error = 96;
+
+  /*the minimum sum heuristic, as filter() uses for LFS_MINSUM*/
+  for(type = 0; type != 5; ++type)
+  {
+    unsigned char* attempt = &stream->attempt[type * (linebytes + 1)];
+    attempt[0] = type;
+    filterScanline(&attempt[1], scanline, stream->rows ? stream->prevline : 0,
+                   linebytes, stream->bytewidth, type);
+
+    sum = 0;
+    if(type == 0)
+    {
+      for(x = 1; x <= linebytes; ++x) sum += attempt[x];
+    }
+    else
+    {
+      for(x = 1; x <= linebytes; ++x)
+      {
+        unsigned char s = attempt[x];
+        sum += s < 128 ? s : (255U - s);
+      }
+    }
+
+    if(type == 0 || sum < smallest)
+    {
+      bestType = type;
+      smallest = sum;
+    }
+  }
+
+  best = &stream->attempt[bestType * (linebytes + 1)];
+  memcpy(&stream->data[stream->datasize], best, linebytes + 1);
+  stream->datasize += linebytes + 1;
+  stream->adler = update_adler32(stream->adler, best, (unsigned)(linebytes + 1));
+  memcpy(stream->prevline, scanline, linebytes);
+  ++stream->rows;
+
+  if(stream->datasize - stream->datapos >= STREAM_BLOCK_SIZE && stream->rows != stream->h)
+  {
+    stream->error = stream_deflate(stream, 0);
+  }
+  return stream->error;
+}
+
+unsigned lodepng_stream_finish(LodePNGStreamEncoder* stream)
+{
+  ucvector v;
+
+  if(stream->error) return stream->error;
+  if(!stream->data || stream->rows != stream->h) return stream->error = 96;
+
+  stream->error = stream_deflate(stream, 1);
+  if(stream->error) return stream->error;
+
+  /*what's left is the last, partly filled byte of the final block, then the adler32*/
+  v.data = stream->deflated;
+  v.size = stream->deflatedsize;
+  v.allocsize = stream->deflatedalloc;
+  lodepng_add32bitInt(&v, stream->adler);
+  stream->deflated = v.data;
+  stream->deflatedsize = v.size;
+  stream->deflatedalloc = v.allocsize;
+
+  stream->error = stream_write_chunk(stream, "IDAT", stream->deflated, stream->deflatedsize);
+  if(!stream->error) stream->error = stream_write_chunk(stream, "IEND", 0, 0);
+  if(!stream->error) stream->rows = stream->h + 1; /*done: no more rows or finishing*/
+  return stream->error;
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
 unsigned lodepng_encode_memory(unsigned char** out, size_t* outsize, const unsigned char* image,
                                unsigned w, unsigned h, LodePNGColorType colortype, unsigned bitdepth)
 {
@@ -5998,6 +6254,9 @@ const char* lodepng_error_text(unsigned code)
     case 92: return "too many pixels, not supported";
     case 93: return "zero width or height is invalid";
     case 94: return "header chunk must have a size of 13 bytes";
+    /*the streaming encoder only does what PNG screenshots and video frames need*/
+    case 95: return "streaming encoder supports only 8-bit RGB or RGBA, with btype 1 or 2";
+    case 96: return "streaming encoder given the wrong number of scanlines";
   }
   return "unknown error code";
 }
@@ -6223,6 +6482,47 @@ unsigned encode(const std::string& filename,
   if(lodepng_get_raw_size_lct(w, h, colortype, bitdepth) > in.size()) return 84;
   return encode(filename, in.empty() ? 0 : &in[0], w, h, colortype, bitdepth);
 }
+
+#ifdef LODEPNG_COMPILE_ZLIB
+static unsigned stream_write_file(void* user, const unsigned char* data, size_t size)
+{
+  return fwrite(data, 1, size, (FILE*)user) == size ? 0 : 79;
+}
+
+StreamEncoder::StreamEncoder() : file(0)
+{
+  lodepng_stream_init(this);
+}
+
+StreamEncoder::~StreamEncoder()
+{
+  if(file) fclose(file);
+  lodepng_stream_cleanup(this);
+}
+
+unsigned StreamEncoder::open(const std::string& filename, unsigned w, unsigned h,
+                             LodePNGColorType colortype)
+{
+  if(file) fclose(file);
+  file = fopen(filename.c_str(), "wb");
+  if(!file) return error = 79;
+  return lodepng_stream_begin(this, w, h, colortype, stream_write_file, file);
+}
+
+unsigned StreamEncoder::add_row(const unsigned char* scanline)
+{
+  return lodepng_stream_add_row(this, scanline);
+}
+
+unsigned StreamEncoder::finish()
+{
+  unsigned result = lodepng_stream_finish(this);
+  if(file && fclose(file) != 0 && !result) result = error = 79;
+  file = 0;
+  lodepng_stream_cleanup(this);
+  return result;
+}
+#endif /* LODEPNG_COMPILE_ZLIB */
 #endif /* LODEPNG_COMPILE_DISK */
 #endif /* LODEPNG_COMPILE_ENCODER */
 #endif /* LODEPNG_COMPILE_PNG */
@@ -84,6 +84,9 @@ source files with custom allocators.*/
 #ifdef LODEPNG_COMPILE_CPP
 #include <vector>
 #include <string>
+#ifdef LODEPNG_COMPILE_DISK
+#include <stdio.h>
+#endif /*LODEPNG_COMPILE_DISK*/
 #endif /*LODEPNG_COMPILE_CPP*/
 
 #ifdef LODEPNG_COMPILE_PNG
@@ -667,6 +670,67 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h,
 unsigned lodepng_encode(unsigned char** out, size_t* outsize,
                         const unsigned char* image, unsigned w, unsigned h,
                         LodePNGState* state);
+
+#ifdef LODEPNG_COMPILE_ZLIB
+/*
+Streaming encoder: encodes a PNG one scanline at a time. Each scanline is
+filtered (with the minimum sum heuristic) as it is added, the filtered data is
+deflated a block at a time, and every finished block is handed to the write
+callback as an IDAT chunk. Only the last few scanlines and the LZ77 window are
+kept in memory, so images of any size can be written in constant memory.
+
+Only 8-bit LCT_RGB and LCT_RGBA, non-interlaced, and zlibsettings.btype 1 or 2
+are supported. custom_zlib and custom_deflate are ignored.
+
+  LodePNGStreamEncoder stream;
+  lodepng_stream_init(&stream);
+  error = lodepng_stream_begin(&stream, w, h, LCT_RGBA, write, user);
+  for(y = 0; !error && y < h; ++y) error = lodepng_stream_add_row(&stream, row(y));
+  if(!error) error = lodepng_stream_finish(&stream);
+  lodepng_stream_cleanup(&stream);
+*/
+
+/*
+Called with each consecutive piece of the PNG file. Return 0 on success, or
+nonzero to stop encoding: that value is then returned as the error.
+*/
+typedef unsigned (*LodePNGStreamWrite)(void* user, const unsigned char* data, size_t size);
+
+typedef struct LodePNGStreamEncoder
+{
+  /*may be changed between lodepng_stream_init and lodepng_stream_begin*/
+  LodePNGCompressSettings zlibsettings;
+
+  /*the rest is private*/
+  LodePNGStreamWrite write;
+  void* user;
+  unsigned w, h;
+  size_t bytewidth; /*bytes per pixel*/
+  size_t linebytes; /*bytes per scanline, without the filter type byte*/
+  unsigned rows; /*scanlines added so far*/
+  unsigned error; /*the first error, after which nothing more is done*/
+  unsigned adler; /*adler32 of the filtered data so far*/
+  unsigned char* prevline; /*the last scanline, unfiltered*/
+  unsigned char* attempt; /*5 scanlines, one per filter type, each with its type byte*/
+  unsigned char* data; /*the LZ77 window followed by the filtered data not yet deflated*/
+  size_t datasize, datapos, dataalloc; /*data before datapos is already deflated*/
+  unsigned char* deflated; /*deflated bytes not yet written, the last maybe partial*/
+  size_t deflatedsize, deflatedalloc;
+  size_t bp; /*bit pointer in deflated*/
+  void* hash; /*the LZ77 hash, kept across blocks*/
+} LodePNGStreamEncoder;
+
+void lodepng_stream_init(LodePNGStreamEncoder* stream);
+/*frees what the stream allocated, keeping the settings. Does not write anything.*/
+void lodepng_stream_cleanup(LodePNGStreamEncoder* stream);
+/*start a w x h PNG: writes the signature and header*/
+unsigned lodepng_stream_begin(LodePNGStreamEncoder* stream, unsigned w, unsigned h,
+                              LodePNGColorType colortype, LodePNGStreamWrite write, void* user);
+/*add the next scanline down: w pixels of the color type given to lodepng_stream_begin*/
+unsigned lodepng_stream_add_row(LodePNGStreamEncoder* stream, const unsigned char* scanline);
+/*after the last scanline: writes the rest of the image data and the end chunk*/
+unsigned lodepng_stream_finish(LodePNGStreamEncoder* stream);
+#endif /*LODEPNG_COMPILE_ZLIB*/
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 /*
@@ -844,6 +908,36 @@ unsigned encode(std::vector<unsigned char>& out,
 unsigned encode(std::vector<unsigned char>& out,
                 const std::vector<unsigned char>& in, unsigned w, unsigned h,
                 State& state);
+
+#if defined(LODEPNG_COMPILE_ZLIB) && defined(LODEPNG_COMPILE_DISK)
+/*
+The streaming encoder (see LodePNGStreamEncoder), writing to a file:
+
+  lodepng::StreamEncoder png;
+  unsigned error = png.open("big.png", w, h);
+  for(unsigned y = 0; !error && y < h; ++y) error = png.add_row(row(y));
+  if(!error) error = png.finish();
+*/
+class StreamEncoder : public LodePNGStreamEncoder
+{
+  public:
+    StreamEncoder();
+    /* Closes the file, finished or not. */
+    virtual ~StreamEncoder();
+    /* Start writing a w x h PNG to filename. The file is overwritten without warning. */
+    unsigned open(const std::string& filename, unsigned w, unsigned h,
+                  LodePNGColorType colortype = LCT_RGBA);
+    /* Add the next scanline down. */
+    unsigned add_row(const unsigned char* scanline);
+    /* Write the end of the PNG and close the file. */
+    unsigned finish();
+
+  private:
+    FILE* file;
+    StreamEncoder(const StreamEncoder&);
+    StreamEncoder& operator=(const StreamEncoder&);
+};
+#endif /*defined(LODEPNG_COMPILE_ZLIB) && defined(LODEPNG_COMPILE_DISK)*/
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 #ifdef LODEPNG_COMPILE_DISK
@@ -1,58 +1,25 @@
 #include "arrow.h"
-#include "scene.h"
 
-// Draw a wireframe axis-aligned box whose opposite corners are given by the
-// points 'min' and 'max'.
-void draw_box(const Vec3f& min, const Vec3f& max) {
-  glBegin(GL_LINE_LOOP);
-  glVertex3d(min[0], min[1], min[2]);
-  glVertex3d(min[0], max[1], min[2]);
-  glVertex3d(max[0], max[1], min[2]);
-  glVertex3d(max[0], min[1], min[2]);
-  glEnd();
-
-  glBegin(GL_LINE_LOOP);
-  glVertex3d(min[0], min[1], max[2]);
-  glVertex3d(min[0], max[1], max[2]);
-  glVertex3d(max[0], max[1], max[2]);
-  glVertex3d(max[0], min[1], max[2]);
-  glEnd();
-
-  glBegin(GL_LINES);
-  glVertex3d(min[0], min[1], min[2]);
-  glVertex3d(min[0], min[1], max[2]);
-  glVertex3d(min[0], max[1], min[2]);
-  glVertex3d(min[0], max[1], max[2]);
-  glVertex3d(max[0], max[1], min[2]);
-  glVertex3d(max[0], max[1], max[2]);
-  glVertex3d(max[0], min[1], min[2]);
-  glVertex3d(max[0], min[1], max[2]);
-  glEnd();
+void Arrow::point(Vec3f dir) {
+  basis(dir, axes);
 }
 
-void Arrow::draw() {
-  glColor4fv(color);
-  apply_transform();
-
-  glBegin(GL_TRIANGLE_FAN);             // the front pyramid
-  glVertex3d(0., 0., scene.fsize * 3);  // height
-  glVertex3d(scene.fsize, 0., 0.);
-  glVertex3d(0., -scene.fsize, 0.);
-  glVertex3d(-scene.fsize, 0., 0.);
-  glVertex3d(0., scene.fsize, 0.);
-  glEnd();
+// the branchless version of Frisvad's construction, from Duff et al.,
+// "Building an Orthonormal Basis, Revisited" (JCGT 2017)
+void Arrow::basis(const Vec3f& dir, Vec3f axes[3]) {
+  double n = norm(dir);
+  if (n == 0) {
+    axes[0] = Vec3f(1, 0, 0);
+    axes[1] = Vec3f(0, 1, 0);
+    axes[2] = Vec3f(0, 0, 1);
+    return;
+  }
 
-  glBegin(GL_TRIANGLE_FAN);              // the butt pyramid
-  glVertex3d(0., 0., -scene.fsize * 2);  // height
-  glVertex3d(scene.fsize, 0., 0.);
-  glVertex3d(0., -scene.fsize, 0.);
-  glVertex3d(-scene.fsize, 0., 0.);
-  glVertex3d(0., scene.fsize, 0.);
-  glEnd();
-}
-
-void Arrow::point(Vec3f dir) {
-  double angle = acos(Vec3f(0, 0, 1) * unit_vec(dir));
-  rot_axis = unit_vec(cross(Vec3f(0, 0, 1), dir));
-  rot_angle = RAD_TO_DEG(angle);
+  float x = dir[0] / n, y = dir[1] / n, z = dir[2] / n;
+  float sign = copysignf(1.f, z);
+  float a = -1.f / (sign + z);
+  float b = x * y * a;
+  axes[0] = Vec3f(1.f + sign * x * x * a, sign * b, -sign * x);
+  axes[1] = Vec3f(b, sign + y * y * a, -y);
+  axes[2] = Vec3f(x, y, z);
 }
@@ -13,18 +13,22 @@ class Arrow : public Control {
   rgbColor color;
   Vec3f velocity;  // current velocity
   Vec3f accel;     // current acceleration
+  Vec3f axes[3];   // my orientation; axes[2] points the way I'm going
 
-  Arrow() : hsv(0.0f, 0.8f, 0.8f, 1.0f) {}
+  Arrow() : hsv(0.0f, 0.8f, 0.8f, 1.0f) {
+    axes[0] = Vec3f(1, 0, 0);
+    axes[1] = Vec3f(0, 1, 0);
+    axes[2] = Vec3f(0, 0, 1);
+  }
   virtual ~Arrow() {}
 
-  // draw the Arrow
-  virtual void draw();
   // let t seconds elapse
   virtual void elapse(double t) = 0;
   // point me in direction of 'dir'.
   void point(Vec3f dir);
+  // an orthonormal basis with axes[2] pointing in direction of 'dir' (or
+  // the identity if dir is 0). there's no trig, just a square root.
+  static void basis(const Vec3f& dir, Vec3f axes[3]);
 };
 
-void draw_box(const Vec3f& min, const Vec3f& max);
-
 #endif  // Arrow.h
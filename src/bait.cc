@@ -2,7 +2,7 @@
 #include "modes.h"
 #include "scene.h"
 
-Bait::Bait() : Arrow() {
+Bait::Bait() : Arrow(), id(scene.next_bait_id++) {
   age = rand_real(0., 10.);
   fuzz = rand_real(0.7, 1.4);
   glow = false;
@@ -31,24 +31,15 @@ Bait::Bait() : Arrow() {
 #endif
 }
 
-void Bait::draw() {
-  if (!scene.draw_bait)
-    return;
-
-  glPushMatrix();
-  Arrow::draw();
-  glPopMatrix();
+Bait::~Bait() {
+  scene.events.cancel(mode_event);
+  cancel_stops();
 }
 
 void Bait::elapse(double t) {
   hsv[0] += hue_rate * t;
   age += t;
 
-  if (age >= mode_when)
-    bait_start_mode(this, mode_next);
-  while (stop_timer.is_ready(age))
-    bait_stop_mode(this, stop_timer.pop());
-
   calc_accel();
   velocity += accel * t;
   clamp_vec(velocity, bspeed);
@@ -58,6 +49,27 @@ void Bait::elapse(double t) {
   set_color();
 }
 
+void Bait::schedule_stop(int mode, double delay) {
+  // drop the stops that have already happened
+  unsigned i = 0;
+  while (i < stop_events.size()) {
+    if (scene.events.pending(stop_events[i]))
+      i++;
+    else {
+      stop_events[i] = stop_events.back();
+      stop_events.pop_back();
+    }
+  }
+  stop_events.push_back(
+      scene.events.add(scene.curtime + delay, EVENT_BAIT_STOP, mode, this));
+}
+
+void Bait::cancel_stops() {
+  for (unsigned i = 0; i < stop_events.size(); i++)
+    scene.events.cancel(stop_events[i]);
+  stop_events.clear();
+}
+
 void Bait::calc_accel() {
   if (attractor) {
     accel = baccel * unit_vec((*attractor) - pos);
@@ -66,11 +78,12 @@ void Bait::calc_accel() {
 
   // time to turn
   if (age >= turn_when) {
+    Rng rng = Rng::stream(RNG_BAIT, id, scene.step);
     for (int i = 0; i < 3; i++) {
-      if (rand_int(0, 1) == 0)
+      if (rand_int(rng, 0, 1) == 0)
         accel[i] = -SIGN(accel[i]) * baccel;
     }
-    turn_when = age + rand_real(0.5, turn_delay);
+    turn_when = age + rand_real(rng, 0.5, turn_delay);
   }
 
   for (int i = 0; i < 3; i++) {
@@ -82,13 +95,6 @@ void Bait::calc_accel() {
 }
 
 void Bait::set_color() {
-  // keep everything as before
-
-  // clamp to my range
-  while (hsv[0] > 360.f)
-    hsv[0] -= 360.f;
-  while (hsv[0] < 0.f)
-    hsv[0] += 360.f;
-
+  hsv[0] = wrap_hue(hsv[0]);
   color = hsv_to_rgb(hsv);
 }
@@ -3,16 +3,18 @@
 
 #include "utils.h"
 #include "arrow.h"
+#include "events.h"
 
 class Bait : public Arrow {
  public:
+  unsigned id;        // unique per bait; keys its random stream
   double age;         // timer with random initial value
   double fuzz;        // my little bit of randomness
   double turn_delay;  // max delay before turning (higher = slower changing)
   double turn_when;   // when to change acceleration (referenced from timer)
   int mode_next;      // the next mode to activate
-  double mode_when;   // next time to activate a mode (ref timer)
-  Timer stop_timer;   // timer for stopping events
+  EventHandle mode_event;           // when to activate it, in scene.events
+  vector<EventHandle> stop_events;  // when to stop the modes I'm in
 
   // options
   double bspeed;    // my speed
@@ -24,12 +26,19 @@ class Bait : public Arrow {
 
   Vec3f* attractor;
 
+  // indices into scene.flies of the flies chasing me, in no order. the
+  // FlyPool keeps this up to date.
+  vector<unsigned> members;
+
   Bait();
+  virtual ~Bait();
 
-  // draw me
-  virtual void draw();
   // let t seconds elapse
   virtual void elapse(double t);
+  // stop 'mode' in 'delay' seconds
+  void schedule_stop(int mode, double delay);
+  // forget about stopping any modes
+  void cancel_stops();
   // calculate acceleration
   virtual void calc_accel();
   // change colors based on parameters
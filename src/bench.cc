@@ -0,0 +1,348 @@
+// fireflies-bench: time the simulation on a few fixed, seeded scenes and
+// print where the time goes as JSON, so builds can be compared. with
+// -check, instead check that every fly kernel this CPU runs agrees with
+// the scalar one on those scenes.
+
+#include "main.h"
+#include "scene.h"
+#include "flykernel.h"
+#include "modes.h"
+
+#include <iostream>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <argp.h>
+
+Scene scene;
+
+struct Scenario {
+  const char* name;
+  unsigned flies;
+  unsigned baits;
+  double tail_length;
+  unsigned steps;  // steps timed, after the tails have filled up
+};
+
+// bigger scenes get shorter tails and fewer steps, so the whole suite
+// fits in a few GB and a few minutes
+static Scenario scenarios[] = {
+    {"1k", 1000, 3, 2.25, 1000},
+    {"10k", 10000, 5, 2.25, 300},
+    {"100k", 100000, 10, 1.0, 100},
+    {"1M", 1000000, 20, 0.5, 30},
+};
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+static const char* phase_names[NUM_PHASES] = {"modes", "baits", "flies",
+                                              "tails", "reap"};
+
+static unsigned threads = 1;
+static uint64_t seed = 1;
+static unsigned steps = 0;  // 0 = each scenario's own count
+static double fps = 30.;
+static const char* output = 0;
+static bool only[NUM_SCENARIOS];  // scenarios picked with --scenario
+static bool any_only = false;
+static bool check = false;
+
+// how far a SIMD fly kernel may stray from the scalar one, relative to
+// the size of the value. they do the same float operations in the same
+// order, so anything past rounding is a bug.
+#define CHECK_EPSILON 1e-5
+
+#define OPT_THREADS 1
+#define OPT_SEED 2
+#define OPT_STEPS 3
+#define OPT_FPS 4
+#define OPT_SCENARIO 5
+#define OPT_OUTPUT 6
+#define OPT_CHECK 7
+
+const char* argp_program_version =
+    "Fireflies " PACKAGE_VERSION " by Mattperry <mpcomplete@gmail.com>";
+
+static char doc[] =
+    "Time the fireflies simulation on fixed scenes of 1k, 10k, 100k and 1M "
+    "flies, and print nanoseconds per fly per step for each phase as JSON.";
+
+static struct argp_option options[] = {
+    {"threads", OPT_THREADS, "NUM", 0,
+     "Simulation threads, 0 = one per CPU (default = 1)"},
+    {"seed", OPT_SEED, "NUM", 0, "Random seed (default = 1)"},
+    {"steps", OPT_STEPS, "NUM", 0,
+     "Steps to time in every scenario (default = depends on the scenario)"},
+    {"fps", OPT_FPS, "NUM", 0, "Steps per simulated second (default = 30)"},
+    {"scenario", OPT_SCENARIO, "NAME", 0,
+     "Only run this scenario (1k, 10k, 100k or 1M). May be repeated."},
+    {"output", OPT_OUTPUT, "FILE", 0, "Write the JSON here, not to stdout"},
+    {"check", OPT_CHECK, 0, 0,
+     "Don't time anything: check that the SIMD fly and color kernels match "
+     "the scalar ones on each scenario"},
+    {0, 0, 0, 0}};
+
+static int parse_opt(int key, char* arg, struct argp_state* state) {
+  switch (key) {
+    case OPT_THREADS:
+      threads = (unsigned)atoi(arg);
+      break;
+    case OPT_SEED:
+      seed = strtoull(arg, 0, 0);
+      break;
+    case OPT_STEPS:
+      steps = (unsigned)atoi(arg);
+      break;
+    case OPT_FPS:
+      fps = atof(arg);
+      if (fps <= 0) {
+        cerr << state->name << ": -fps must be > 0" << endl;
+        return -1;
+      }
+      break;
+    case OPT_SCENARIO: {
+      unsigned i;
+      for (i = 0; i < NUM_SCENARIOS; i++) {
+        if (strcasecmp(arg, scenarios[i].name) == 0)
+          break;
+      }
+      if (i == NUM_SCENARIOS) {
+        cerr << state->name << ": no scenario named " << arg << endl;
+        return -1;
+      }
+      only[i] = true;
+      any_only = true;
+      break;
+    }
+    case OPT_OUTPUT:
+      output = arg;
+      break;
+    case OPT_CHECK:
+      check = true;
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+  }
+  return 0;
+}
+
+static struct argp argp_s = {options, parse_opt, 0, doc};
+
+// set up scenario s, and step it until the tails have filled up
+static void start(const Scenario& s) {
+  scene.phase_times = 0;
+  scene.clear();
+  scene.set_defaults();
+  scene.threads = threads;
+  scene.seed = seed;
+  scene.random_seed = false;
+  scene.fps = fps;
+  scene.minbaits = scene.maxbaits = s.baits;
+  // leave room for flykill and flybirth, so dead tails get reaped
+  scene.minflies = s.flies - s.flies / 5;
+  scene.maxflies = s.flies + s.flies / 5;
+  scene.tail_length = s.tail_length;
+  // matrix mode freezes everything but the camera
+  scene.smodes.change(SMODE_MATRIX, 0);
+
+  scene.resize(1280, 720);
+  scene.create();
+
+  // let the tails fill up first
+  double t = 1.0 / fps;
+  unsigned warmup = (unsigned)ceil(s.tail_length * fps);
+  for (unsigned i = 0; i < warmup; i++)
+    scene.elapse_once(t);
+}
+
+// run scenario s, and return its timings in 'times'
+static void run(const Scenario& s, PhaseTimes& times) {
+  start(s);
+
+  double t = 1.0 / fps;
+  times.clear();
+  scene.phase_times = &times;
+  unsigned n = steps ? steps : s.steps;
+  for (unsigned i = 0; i < n; i++)
+    scene.elapse_once(t);
+  scene.phase_times = 0;
+}
+
+// the outputs of one run of the kernels over the whole pool
+struct KernelOutput {
+  vector<float> px, py, pz, vx, vy, vz, ax, ay, az, hue;
+  vector<uint32_t> rgba;
+};
+
+// run kernel version 'which', through fly_kernel() and color_kernel(), on
+// the flies as they are now. the pool itself is left alone. color_kernel()
+// is given 'hue' if it's not empty, so the color kernels can be compared
+// on the same input.
+static void run_kernels(int which, const vector<float>& hue,
+                        KernelOutput& out) {
+  FlyPool& p = scene.flies;
+  unsigned n = p.size();
+  out.px = p.pos.x;
+  out.py = p.pos.y;
+  out.pz = p.pos.z;
+  out.vx = p.velocity.x;
+  out.vy = p.velocity.y;
+  out.vz = p.velocity.z;
+  out.ax.assign(n, 0.f);
+  out.ay.assign(n, 0.f);
+  out.az.assign(n, 0.f);
+  out.hue.assign(n, 0.f);
+  out.rgba.assign(n, 0);
+
+  fly_kernel_select(which);
+  FlyKernelArgs a;
+  a.px = &out.px[0];
+  a.py = &out.py[0];
+  a.pz = &out.pz[0];
+  a.vx = &out.vx[0];
+  a.vy = &out.vy[0];
+  a.vz = &out.vz[0];
+  a.ax = &out.ax[0];
+  a.ay = &out.ay[0];
+  a.az = &out.az[0];
+  a.hue = &out.hue[0];
+  a.bait = &p.bait[0];
+  a.baits = &p.kernel_baits();
+  a.t = 1.0 / fps;
+  fly_kernel(a, 0, n);
+
+  ColorKernelArgs c;
+  c.hue = hue.empty() ? &out.hue[0] : &hue[0];
+  c.bait = &p.bait[0];
+  c.baits = &p.kernel_baits();
+  c.rgba = &out.rgba[0];
+  color_kernel(c, 0, n);
+}
+
+// the biggest difference between 'a' and 'b', relative to their size
+static double max_error(const vector<float>& a, const vector<float>& b) {
+  double worst = 0.;
+  for (unsigned i = 0; i < a.size(); i++) {
+    double err = fabs(a[i] - b[i]) / max(1., (double)fabs(a[i]));
+    if (err != err)  // NaN
+      return HUGE_VAL;
+    worst = max(worst, err);
+  }
+  return worst;
+}
+
+// check every kernel version this CPU supports against the scalar one on
+// scenario s. returns false (and says where) if any disagrees.
+static bool check_kernels(const Scenario& s) {
+  start(s);
+  if (scene.flies.empty()) {
+    cerr << s.name << ": no flies to check" << endl;
+    return false;
+  }
+
+  KernelOutput ref;
+  run_kernels(FLYKERNEL_SCALAR, vector<float>(), ref);
+
+  bool ok = true;
+  int best = fly_kernel_best();
+  for (int k = FLYKERNEL_SCALAR + 1; k <= best; k++) {
+    KernelOutput out;
+    run_kernels(k, vector<float>(), out);
+    const char* name = fly_kernel_name();
+
+    const vector<float>* fields[][2] = {
+        {&ref.px, &out.px}, {&ref.py, &out.py}, {&ref.pz, &out.pz},
+        {&ref.vx, &out.vx}, {&ref.vy, &out.vy}, {&ref.vz, &out.vz},
+        {&ref.ax, &out.ax}, {&ref.ay, &out.ay}, {&ref.az, &out.az},
+        {&ref.hue, &out.hue}};
+    double worst = 0.;
+    for (unsigned f = 0; f < sizeof(fields) / sizeof(fields[0]); f++)
+      worst = max(worst, max_error(*fields[f][0], *fields[f][1]));
+    bool fly_ok = worst <= CHECK_EPSILON;
+
+    // the color kernels agree exactly given the same hues
+    KernelOutput color;
+    run_kernels(k, ref.hue, color);
+    unsigned wrong = 0;
+    for (unsigned i = 0; i < ref.rgba.size(); i++) {
+      if (color.rgba[i] != ref.rgba[i])
+        wrong++;
+    }
+
+    cerr << s.name << ": " << name << " fly kernel max error " << worst
+         << (fly_ok ? "" : " FAILED") << ", color kernel " << wrong
+         << " of " << ref.rgba.size() << " flies differ"
+         << (wrong ? " FAILED" : "") << endl;
+    ok = ok && fly_ok && !wrong;
+  }
+  if (best == FLYKERNEL_SCALAR)
+    cerr << s.name << ": only the scalar kernels run here" << endl;
+
+  fly_kernel_select(best);
+  return ok;
+}
+
+static void write_json(ostream& out, const Scenario& s,
+                       const PhaseTimes& times, bool last) {
+  char buf[64];
+  double total = 0.;
+  double per = times.fly_steps ? 1e9 / times.fly_steps : 0.;
+
+  out << "    {\"name\": \"" << s.name << "\", \"flies\": " << s.flies
+      << ", \"baits\": " << s.baits << ", \"tail_length\": " << s.tail_length
+      << ", \"steps\": " << times.steps
+      << ", \"fly_steps\": " << times.fly_steps << "," << endl;
+  out << "     \"ns_per_fly_step\": {";
+  for (int p = 0; p < NUM_PHASES; p++) {
+    snprintf(buf, sizeof(buf), "%.3f", times.secs[p] * per);
+    out << "\"" << phase_names[p] << "\": " << buf << ", ";
+    total += times.secs[p];
+  }
+  snprintf(buf, sizeof(buf), "%.3f", total * per);
+  out << "\"total\": " << buf << "}}" << (last ? "" : ",") << endl;
+}
+
+int main(int argc, char** argv) {
+  if (argp_parse(&argp_s, argc, argv, ARGP_LONG_ONLY, 0, 0) != 0)
+    return 1;
+
+  vector<const Scenario*> picked;
+  for (unsigned i = 0; i < NUM_SCENARIOS; i++) {
+    if (!any_only || only[i])
+      picked.push_back(&scenarios[i]);
+  }
+
+  if (check) {
+    bool ok = true;
+    for (unsigned i = 0; i < picked.size(); i++)
+      ok = check_kernels(*picked[i]) && ok;
+    return ok ? 0 : 1;
+  }
+
+  ofstream file;
+  if (output) {
+    file.open(output);
+    if (!file) {
+      cerr << argv[0] << ": can't write " << output << endl;
+      return 1;
+    }
+  }
+  ostream& out = output ? file : cout;
+
+  out << "{" << endl;
+  out << "  \"version\": \"" PACKAGE_VERSION "\", \"kernel\": \""
+      << fly_kernel_name() << "\", \"threads\": " << threads
+      << ", \"seed\": " << seed << ", \"fps\": " << fps << "," << endl;
+  out << "  \"scenarios\": [" << endl;
+  for (unsigned i = 0; i < picked.size(); i++) {
+    PhaseTimes times;
+    cerr << "running " << picked[i]->name << "..." << endl;
+    run(*picked[i], times);
+    write_json(out, *picked[i], times, i + 1 == picked.size());
+  }
+  out << "  ]" << endl;
+  out << "}" << endl;
+
+  return 0;
+}
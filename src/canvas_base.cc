@@ -12,22 +12,36 @@
 #include <unistd.h>
 #endif
 
+// screenshots are drawn a tile at a time into this framebuffer, no more
+// than SCREENSHOT_TILE on a side, and read back a band of tiles at a time.
+// hardly anyone takes one, so it's only made for the first, and let go
+// once there hasn't been one for SCREENSHOT_IDLE ms.
+#define SCREENSHOT_TILE 2048
+#define SCREENSHOT_IDLE 60000
 static GLuint screenshot_framebuffer = 0;
-static GLubyte* screenshot_pixels = NULL;
-static const GLuint DPI = 200;
-static const GLuint SCREENSHOT_WIDTH = 36*DPI;
-static const GLuint SCREENSHOT_HEIGHT = 24*DPI;
-static const GLenum SCREENSHOT_FORMAT = GL_RGBA;
-static const GLuint SCREENSHOT_FORMAT_NBYTES = 4;
-
-static void create_screenshot_texture();
-static void save_screenshot();
+static GLuint screenshot_color = 0;
+static GLuint screenshot_depth = 0;
+static int tile_width = 0;
+static int tile_height = 0;
+static vector<unsigned char> screenshot_band;  // RGBA, bottom row first
+static int last_screenshot = 0;  // get_ms() when the last one was done
+
+static bool create_screenshot_texture(int shot_width, int shot_height,
+                                      GLuint restore);
+static void release_screenshot_texture();
+static void screenshot_name(char* filename, size_t size);
+static bool file_exists(const char* filename);
 
 CanvasBase::CanvasBase(Scene* s, bool fs, int m)
-    : scene(s), full_screen(fs), mspf(m) {
+    : scene(s), renderer(s, &stream), full_screen(fs), mspf(m) {
   animate = true;
   need_refresh = true;
+  framebuffer = 0;
   width = height = 0;
+  // 36x24 inches at 200 dpi
+  shot_width = 7200;
+  shot_height = 4800;
+  record_to = 0;
 }
 
 int CanvasBase::create_window() {
@@ -37,21 +51,23 @@ int CanvasBase::create_window() {
 }
 
 int CanvasBase::init() {
+  if (scene->random_seed) {
 #ifdef WIN32
-  srand(time(0));
+    scene->seed = time(0);
 #else
-
-  struct timeval tv;
-  gettimeofday(&tv, 0);
-  srand(1000 * tv.tv_sec + tv.tv_usec / 1000);
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    scene->seed = 1000 * (uint64_t)tv.tv_sec + tv.tv_usec / 1000;
 #endif
+  }
 
   int ret;
   if ((ret = create_window()) < 0)
     return ret;
 
-  create_screenshot_texture();
   resize();
+  if (record_to && recorder.start(record_to, width, height, mspf) < 0)
+    return -1;
   last_tick = get_ms();
 
   return 0;
@@ -59,13 +75,19 @@ int CanvasBase::init() {
 
 void CanvasBase::resize() {
   glViewport(0, 0, width, height);
-  scene->resize(width, height);
+  renderer.resize(width, height);
 }
 
 void CanvasBase::draw() {
+  paint();
+  recorder.capture(width, height);
+}
+
+void CanvasBase::paint() {
+  TRACE_SCOPE("draw");
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  scene->apply_camera(Vec3(0, 0, 0));
-  scene->draw();
+  renderer.apply_camera(Vec3(0, 0, 0));
+  renderer.draw();
 }
 
 int CanvasBase::loop() {
@@ -75,12 +97,16 @@ int CanvasBase::loop() {
   while (true) {
     if ((remain = tick()) > 0)  // time left till tick: sleep
       delay(remain);
-    if ((ret = handle_events()) > 0)  // wants us to quit
+    if ((ret = handle_events()) > 0) {  // wants us to quit
+      recorder.finish();
       return ret;
+    }
   }
 }
 
 int CanvasBase::tick() {
+  check_trace();
+  check_screenshot();
   if (need_refresh) {
     draw();
     need_refresh = false;
@@ -93,7 +119,7 @@ int CanvasBase::tick() {
   if (ms >= mspf) {
     last_tick = now;
     if (animate) {
-      scene->elapse(ms / 1000.0);
+      scene->elapse(frame_time(ms));
       need_refresh = true;
     }
     return 0;
@@ -112,89 +138,149 @@ int CanvasBase::get_ms() {
 
 void CanvasBase::delay(int ms) {}
 
-void CanvasBase::take_screenshot() {
-  glBindFramebuffer(GL_FRAMEBUFFER, screenshot_framebuffer);
-  glViewport(0, 0, SCREENSHOT_WIDTH, SCREENSHOT_HEIGHT);
-  scene->resize(SCREENSHOT_WIDTH, SCREENSHOT_HEIGHT);
+double CanvasBase::frame_time(int ms) const {
+  return recorder.active() ? mspf / 1000.0 : ms / 1000.0;
+}
 
-  CanvasBase::draw();
+void CanvasBase::take_screenshot() {
+  TRACE_SCOPE("screenshot");
+  if (!screenshot_framebuffer &&
+      !create_screenshot_texture(shot_width, shot_height, framebuffer)) {
+    cerr << "Can't make a framebuffer for screenshots" << endl;
+    return;
+  }
 
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glReadBuffer(GL_FRONT);
-  glReadPixels(0, 0, SCREENSHOT_WIDTH, SCREENSHOT_HEIGHT, SCREENSHOT_FORMAT,
-               GL_UNSIGNED_BYTE, screenshot_pixels);
+  char filename[256];
+  screenshot_name(filename, sizeof(filename));
+  lodepng::StreamEncoder png;
+  png.zlibsettings.windowsize = PNG_WINDOW;
+  if (unsigned error = png.open(filename, shot_width, shot_height)) {
+    cerr << "Can't write " << filename << ": " << lodepng_error_text(error)
+         << endl;
+    return;
+  }
+  cerr << "Capturing " << filename << "..." << flush;
 
-  save_screenshot();
+  glBindFramebuffer(GL_FRAMEBUFFER, screenshot_framebuffer);
+  renderer.resize(shot_width, shot_height);
+  glPixelStorei(GL_PACK_ROW_LENGTH, shot_width);
+
+  // go down the picture a band at a time, and across each band a tile at
+  // a time. GL counts rows up from the bottom.
+  for (int top = 0; top < shot_height; top += tile_height) {
+    int rows = min(tile_height, shot_height - top);
+    int y = shot_height - top - rows;
+    for (int x = 0; x < shot_width; x += tile_width) {
+      int cols = min(tile_width, shot_width - x);
+      glViewport(0, 0, cols, rows);
+      renderer.set_tile(shot_width, shot_height, x, y, cols, rows);
+      paint();
+      glReadPixels(0, 0, cols, rows, GL_RGBA, GL_UNSIGNED_BYTE,
+                   &screenshot_band[4 * x]);
+    }
+    for (int i = rows - 1; i >= 0; i--)
+      png.add_row(&screenshot_band[4 * (size_t)shot_width * i]);
+  }
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
   resize();
+  // add_row() keeps the first error, and finish() returns it
+  if (unsigned error = png.finish())
+    cerr << "failed: " << lodepng_error_text(error) << endl;
+  else
+    cerr << "done" << endl;
+  last_screenshot = get_ms();
 }
 
-static void create_screenshot_texture() {
-  // The framebuffer, which regroups 0, 1, or more textures, and 0 or 1 depth
-  // buffer.
-  glGenFramebuffers(1, &screenshot_framebuffer);
-  glBindFramebuffer(GL_FRAMEBUFFER, screenshot_framebuffer);
-
-  // The texture we're going to render to
-  GLuint renderedTexture;
-  glGenTextures(1, &renderedTexture);
-
-  // "Bind" the newly created texture : all future texture functions will modify
-  // this texture
-  glBindTexture(GL_TEXTURE_2D, renderedTexture);
-
-  // Give an empty image to OpenGL ( the last "0" )
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCREENSHOT_WIDTH, SCREENSHOT_HEIGHT,
-               0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+void CanvasBase::dump_trace() {
+  static unsigned int ntraces = 0;
+  char filename[256];
 
-  // Poor filtering. Needed !
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  do {
+    snprintf(filename, sizeof(filename), "trace%d.json", ntraces++);
+  } while (file_exists(filename));
 
-  // The depth buffer
-  GLuint depthrenderbuffer;
-  glGenRenderbuffers(1, &depthrenderbuffer);
-  glBindRenderbuffer(GL_RENDERBUFFER, depthrenderbuffer);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCREENSHOT_WIDTH,
-                        SCREENSHOT_HEIGHT);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                            GL_RENDERBUFFER, depthrenderbuffer);
+  cerr << "Writing " << filename << "..." << flush;
+  if (trace_dump(filename))
+    cerr << "done" << endl;
+  else
+    cerr << "failed" << endl;
+}
 
-  // Set "renderedTexture" as our colour attachement #0
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         renderedTexture, 0);
+void CanvasBase::check_trace() {
+  if (trace_dump_requested())
+    dump_trace();
+}
 
-  // Set the list of draw buffers.
-  GLenum DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-  glDrawBuffers(1, DrawBuffers);  // "1" is the size of DrawBuffers
+void CanvasBase::check_screenshot() {
+  if (screenshot_framebuffer && get_ms() - last_screenshot >= SCREENSHOT_IDLE)
+    release_screenshot_texture();
+}
 
-  // Always check that our framebuffer is ok
-  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    return;
+// make the framebuffer a tile is drawn to, and the band of tiles read
+// back into, for shot_width x shot_height screenshots. restore is bound
+// again when it's done, whether it worked or not.
+static bool create_screenshot_texture(int shot_width, int shot_height,
+                                      GLuint restore) {
+  GLint max_size, max_dims[2];
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+  glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_dims);
+  int side = min(SCREENSHOT_TILE, min(max_size, min(max_dims[0], max_dims[1])));
+
+  // a band holds no more pixels than one whole tile, however wide the
+  // screenshot is
+  tile_width = min(shot_width, side);
+  tile_height = min(shot_height, max(1, min(side, side * side / shot_width)));
+
+  glGenRenderbuffers(1, &screenshot_color);
+  glBindRenderbuffer(GL_RENDERBUFFER, screenshot_color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, tile_width, tile_height);
+  glGenRenderbuffers(1, &screenshot_depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, screenshot_depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, tile_width,
+                        tile_height);
 
-  screenshot_pixels = (GLubyte*)malloc(SCREENSHOT_FORMAT_NBYTES *
-                                       SCREENSHOT_WIDTH * SCREENSHOT_HEIGHT);
+  glGenFramebuffers(1, &screenshot_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, screenshot_framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, screenshot_color);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, screenshot_depth);
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  bool complete =
+      glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, restore);
+
+  if (!complete) {
+    release_screenshot_texture();
+    return false;
+  }
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  screenshot_band.resize(4 * (size_t)shot_width * tile_height);
+  return true;
 }
 
-static bool file_exists(const char* filename) {
-  std::ifstream fin(filename);
-  return fin.good();
+static void release_screenshot_texture() {
+  glDeleteFramebuffers(1, &screenshot_framebuffer);
+  glDeleteRenderbuffers(1, &screenshot_color);
+  glDeleteRenderbuffers(1, &screenshot_depth);
+  screenshot_framebuffer = screenshot_color = screenshot_depth = 0;
+  // clear() would keep the memory
+  vector<unsigned char>().swap(screenshot_band);
 }
 
-static void save_screenshot() {
+// a new screenshot<n>.png, that's not already there
+static void screenshot_name(char* filename, size_t size) {
   static unsigned int nscreenshots = 0;
-  char filename[256];
 
   do {
-    snprintf(filename, sizeof(filename), "screenshot%d.png", nscreenshots++);
+    snprintf(filename, size, "screenshot%d.png", nscreenshots++);
   } while (file_exists(filename));
+}
 
-  cout << "Capturing " << filename << "..." << flush;
-  std::vector<unsigned char> image_buf;
-  lodepng::encode(image_buf, screenshot_pixels, SCREENSHOT_WIDTH, SCREENSHOT_HEIGHT);
-  lodepng::save_file(image_buf, filename);
-  cout << "done" << endl;
-}
\ No newline at end of file
+static bool file_exists(const char* filename) {
+  std::ifstream fin(filename);
+  return fin.good();
+}
@@ -2,14 +2,20 @@
 #define _CANVASBASE_H
 
 #include "scene.h"
+#include "renderer.h"
+#include "recorder.h"
 
 // base class for a GL/DirectX Canvas
 class CanvasBase {
   // protected:
  public:
-  Scene* scene;       // the thing that handles drawing and such
+  Scene* scene;         // the thing that handles animation and such
+  StreamBuffer stream;  // the vertices drawn each frame
+  Renderer renderer;    // the thing that handles drawing
   bool need_refresh;  // do we need to redraw the canvas?
   int last_tick;
+  GLuint framebuffer;  // what draw() draws to: 0 is the window
+  Recorder recorder;   // writes out every frame, with -record
 
   // create the window
   virtual int create_window();
@@ -20,6 +26,9 @@ class CanvasBase {
   bool animate;
   int width;
   int height;
+  const char* record_to;  // where to record every frame to, if anywhere
+  int shot_width;         // size of screenshots, which can be any size
+  int shot_height;
 
   CanvasBase(Scene* s, bool full_screen, int mspf);
   virtual ~CanvasBase() {}
@@ -30,6 +39,8 @@ class CanvasBase {
   virtual void resize();
   // repaint what's on the canvas
   virtual void draw();
+  // draw the scene into the framebuffer that's bound
+  void paint();
   // the event loop. handles events and animates the game
   virtual int loop();
   // tick if it spf seconds have elapsed since last tick
@@ -42,12 +53,21 @@ class CanvasBase {
   virtual int get_ms();
   // delay for specified number of milliseconds
   virtual void delay(int ms);
+  // how far to step the scene when 'ms' have passed since the last frame.
+  // recording steps a steady 1/fps, however long the frames take.
+  double frame_time(int ms) const;
 
-  // Creates a hi-res framebuffer with texture backing, used for screenshotting.
-  void create_texture();
-
-  // Draw the current frame to the hi-res texture.
+  // Draw the current frame at shot_width x shot_height, a tile at a time,
+  // to a new screenshot<n>.png. The framebuffer for it is made the first
+  // time, and kept until check_screenshot() finds it idle.
   void take_screenshot();
+
+  // write out the trace (see trace.h) to a new trace<n>.json
+  void dump_trace();
+  // dump the trace, if a signal asked for one
+  void check_trace();
+  // let go of the screenshot framebuffer if it's been idle a while
+  void check_screenshot();
 };
 
 #endif  // canvas_base.h
@@ -52,7 +52,7 @@ int CanvasGLUT::create_window() {
 
   GLenum err = glewInit();
   if (err != GLEW_OK) {
-    cout << "Error initializing: " << glewGetErrorString(err);
+    cerr << "Error initializing: " << glewGetErrorString(err);
     return -1;
   }
 
@@ -65,6 +65,7 @@ void CanvasGLUT::resize() {
 
 void CanvasGLUT::draw() {
   CanvasBase::draw();
+  TRACE_SCOPE("swap");
   glutSwapBuffers();
 }
 
@@ -74,6 +75,8 @@ int CanvasGLUT::loop() {
 }
 
 void CanvasGLUT::idle() {
+  check_trace();
+  check_screenshot();
   int now = get_ms();
   int ms = now - last_tick;
 
@@ -81,7 +84,7 @@ void CanvasGLUT::idle() {
   if (ms >= mspf) {
     last_tick = now;
     if (animate) {
-      scene->elapse(ms / 1000.0);
+      scene->elapse(frame_time(ms));
       glutPostRedisplay();
     }
   }
@@ -101,6 +104,7 @@ void CanvasGLUT::handle_keypress(unsigned char key) {
   switch (key) {
     case 'q':
     case 27:  // ESC
+      recorder.finish();
       exit(0);
       break;
     case 's':
@@ -110,31 +114,34 @@ void CanvasGLUT::handle_keypress(unsigned char key) {
       animate = !animate;
       break;
     case 't':  // show the time
-      cout << "Elapsed time: " << scene->curtime << "s" << endl;
+      cerr << "Elapsed time: " << scene->curtime << "s" << endl;
+      break;
+    case 'T':  // write out the trace
+      dump_trace();
       break;
     case '+':
       scene->fast_forward *= 2;
-      cout << "fast forward: " << scene->fast_forward << "x" << endl;
+      cerr << "fast forward: " << scene->fast_forward << "x" << endl;
       break;
     case '_':
       if (scene->fast_forward > 1)
         scene->fast_forward /= 2;
-      cout << "fast forward: " << scene->fast_forward << "x" << endl;
+      cerr << "fast forward: " << scene->fast_forward << "x" << endl;
       break;
     case '=':
       scene->fast_forward += 1;
-      cout << "fast forward: " << scene->fast_forward << "x" << endl;
+      cerr << "fast forward: " << scene->fast_forward << "x" << endl;
       break;
     case '-':
       if (scene->fast_forward > 1)
         scene->fast_forward -= 1;
-      cout << "fast forward: " << scene->fast_forward << "x" << endl;
+      cerr << "fast forward: " << scene->fast_forward << "x" << endl;
       break;
     default: {
       int c = key - '0';
       if (c >= 0 && c < NUM_SMODES) {
         scene_start_mode(c);
-        cout << "started scene mode " << c << endl;
+        cerr << "started scene mode " << c << endl;
       }
       break;
     }
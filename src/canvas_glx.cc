@@ -28,7 +28,7 @@ int CanvasGLX::create_window() {
 
   GLenum err = glewInit();
   if (err != GLEW_OK) {
-    cout << "Error initializing: " << glewGetErrorString(err);
+    cerr << "Error initializing: " << glewGetErrorString(err);
     return -1;
   }
 
@@ -47,6 +47,7 @@ void CanvasGLX::resize() {
 void CanvasGLX::draw() {
   CanvasBase::draw();
 
+  TRACE_SCOPE("swap");
   glXSwapBuffers(display, window);
 }
 
@@ -64,6 +65,8 @@ int CanvasGLX::handle_events() {
           take_screenshot();
         if (sym == 'p')
           animate = !animate;
+        if (sym == 'T')
+          dump_trace();
         break;
       }
       case ConfigureNotify:
@@ -89,7 +92,7 @@ void CanvasGLX::delay(int ms) {
 
 static Window create_glx_window(Display* display) {
   if (!display) {
-    printf("Failed to open X display\n");
+    fprintf(stderr, "Failed to open X display\n");
     exit(1);
   }
 
@@ -108,22 +111,22 @@ static Window create_glx_window(Display* display) {
   // FBConfigs were added in GLX version 1.3.
   if (!glXQueryVersion(display, &glx_major, &glx_minor) ||
       ((glx_major == 1) && (glx_minor < 3)) || (glx_major < 1)) {
-    printf("Invalid GLX version");
+    fprintf(stderr, "Invalid GLX version");
     exit(1);
   }
 
-  printf("Getting matching framebuffer configs\n");
+  fprintf(stderr, "Getting matching framebuffer configs\n");
   int fbcount;
   GLXFBConfig* fbc = glXChooseFBConfig(display, DefaultScreen(display),
                                        visual_attribs, &fbcount);
   if (!fbc) {
-    printf("Failed to retrieve a framebuffer config\n");
+    fprintf(stderr, "Failed to retrieve a framebuffer config\n");
     exit(1);
   }
-  printf("Found %d matching FB configs.\n", fbcount);
+  fprintf(stderr, "Found %d matching FB configs.\n", fbcount);
 
   // Pick the FB config/visual with the most samples per pixel
-  printf("Getting XVisualInfos\n");
+  fprintf(stderr, "Getting XVisualInfos\n");
   int best_fbc = -1, worst_fbc = -1, best_num_samp = -1, worst_num_samp = 999;
 
   int i;
@@ -156,7 +159,7 @@ static Window create_glx_window(Display* display) {
   XVisualInfo* vi = glXGetVisualFromFBConfig(display, bestFbc);
   // printf( "Chosen visual ID = 0x%x\n", vi->visualid );
 
-  printf("Creating colormap\n");
+  fprintf(stderr, "Creating colormap\n");
   XSetWindowAttributes swa;
   Colormap cmap;
   swa.colormap = cmap = XCreateColormap(
@@ -168,13 +171,13 @@ static Window create_glx_window(Display* display) {
   Window root = RootWindow(display, vi->screen);
   XWindowAttributes rootAttributes;
   XGetWindowAttributes(display, root, &rootAttributes);
-  printf("Creating window\n");
+  fprintf(stderr, "Creating window\n");
   Window win = XCreateWindow(display, root,
                              0, 0, rootAttributes.width, rootAttributes.height,
                              0, vi->depth, InputOutput, vi->visual,
                              CWBorderPixel | CWColormap | CWEventMask, &swa);
   if (!win) {
-    printf("Failed to create window.\n");
+    fprintf(stderr, "Failed to create window.\n");
     exit(1);
   }
 
@@ -185,7 +188,7 @@ static Window create_glx_window(Display* display) {
 
   XSelectInput(display, win, KeyPressMask | KeyReleaseMask);
 
-  printf("Mapping window\n");
+  fprintf(stderr, "Mapping window\n");
   XMapWindow(display, win);
 
   GLXContext ctx =
@@ -195,18 +198,18 @@ static Window create_glx_window(Display* display) {
   XSync(display, False);
 
   if (!ctx) {
-    printf("Failed to create an OpenGL context\n");
+    fprintf(stderr, "Failed to create an OpenGL context\n");
     exit(1);
   }
 
   // Verifying that context is a direct context
   if (!glXIsDirect(display, ctx)) {
-    printf("Indirect GLX rendering context obtained\n");
+    fprintf(stderr, "Indirect GLX rendering context obtained\n");
   } else {
-    printf("Direct GLX rendering context obtained\n");
+    fprintf(stderr, "Direct GLX rendering context obtained\n");
   }
 
-  printf("Making context current\n");
+  fprintf(stderr, "Making context current\n");
   glXMakeCurrent(display, win, ctx);
 
   return win;
@@ -0,0 +1,150 @@
+#include "canvas_offscreen.h"
+
+#include <iostream>
+#include <string.h>
+#include <sys/time.h>
+
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static EGLDisplay get_display();
+
+CanvasOffscreen::CanvasOffscreen(Scene* s, int m, int w, int h, unsigned n,
+                                 bool sh)
+    : CanvasBase(s, false, m), frames(n), shoot(sh) {
+  display = EGL_NO_DISPLAY;
+  context = EGL_NO_CONTEXT;
+  color_buffer = depth_buffer = 0;
+  width = w;
+  height = h;
+}
+
+CanvasOffscreen::~CanvasOffscreen() {
+  if (display == EGL_NO_DISPLAY)
+    return;
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (context != EGL_NO_CONTEXT)
+    eglDestroyContext(display, context);
+  eglTerminate(display);
+}
+
+int CanvasOffscreen::create_window() {
+  EGLint major, minor;
+  if ((display = get_display()) == EGL_NO_DISPLAY ||
+      !eglInitialize(display, &major, &minor)) {
+    cerr << "Can't open an EGL display" << endl;
+    return -1;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    cerr << "EGL has no desktop OpenGL" << endl;
+    return -1;
+  }
+
+  // we never draw to an EGL surface, so any config will do, or none at
+  // all where EGL_KHR_no_config_context lets us
+  static const EGLint config_attribs[] = {
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config = 0;
+  EGLint nconfigs = 0;
+  eglChooseConfig(display, config_attribs, &config, 1, &nconfigs);
+  context = eglCreateContext(display, nconfigs ? config : 0, EGL_NO_CONTEXT, 0);
+  if (context == EGL_NO_CONTEXT ||
+      !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    cerr << "Can't make a surfaceless EGL context" << endl;
+    return -1;
+  }
+
+  GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+  // a GLX build of glew still loads GL fine, it just finds no X display
+  if (err == GLEW_ERROR_NO_GLX_DISPLAY)
+    err = GLEW_OK;
+#endif
+  if (err != GLEW_OK) {
+    cerr << "Error initializing: " << glewGetErrorString(err);
+    return -1;
+  }
+
+  // there's no window system framebuffer, so make our own
+  glGenRenderbuffers(1, &color_buffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenRenderbuffers(1, &depth_buffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, color_buffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_buffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    cerr << "Can't make a " << width << "x" << height << " framebuffer"
+         << endl;
+    return -1;
+  }
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+  cerr << "Drawing offscreen with " << glGetString(GL_RENDERER) << " ("
+       << glGetString(GL_VERSION) << ")" << endl;
+  return 0;
+}
+
+int CanvasOffscreen::loop() {
+  int start = get_ms();
+  unsigned n;
+
+  for (n = 0; frames == 0 || n < frames; n++) {
+    check_trace();
+    if (animate)
+      scene->elapse(mspf / 1000.0);
+    draw();
+  }
+  recorder.finish();
+  glFinish();
+
+  int ms = get_ms() - start;
+  cerr << n << " frames in " << ms / 1000.0 << "s ("
+       << (n ? (double)ms / n : 0.) << " ms/frame)" << endl;
+
+  if (shoot)
+    take_screenshot();
+  return 0;
+}
+
+void CanvasOffscreen::draw() {
+  CanvasBase::draw();
+
+  // nothing to swap, but don't let the driver queue up frames forever
+  TRACE_SCOPE("flush");
+  glFlush();
+}
+
+int CanvasOffscreen::get_ms() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (1000 * tv.tv_sec + tv.tv_usec / 1000);
+}
+
+// Mesa's surfaceless platform needs no X server or DRM device. fall back
+// on the default display where that's missing.
+static EGLDisplay get_display() {
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  const char* exts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+  if (get_platform_display && exts &&
+      strstr(exts, "EGL_MESA_platform_surfaceless")) {
+    EGLDisplay d = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY, 0);
+    if (d != EGL_NO_DISPLAY)
+      return d;
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
@@ -0,0 +1,36 @@
+#ifndef _CANVASOFFSCREEN_H
+#define _CANVASOFFSCREEN_H
+
+#include "canvas_base.h"
+
+#include <EGL/egl.h>
+
+// A Canvas with no window: draws into a framebuffer object on a
+// surfaceless EGL context, so it runs on a machine with no X server or
+// GPU (Mesa's llvmpipe will do). It draws a fixed number of frames as
+// fast as it can, stepping the scene 1/fps each, and says how long they
+// took.
+class CanvasOffscreen : public CanvasBase {
+ protected:
+  EGLDisplay display;
+  EGLContext context;
+  GLuint color_buffer;
+  GLuint depth_buffer;
+  unsigned frames;  // how many to draw, 0 = until killed
+  bool shoot;       // take a screenshot after the last one
+
+  virtual int create_window();
+
+ public:
+  CanvasOffscreen(Scene* s, int mspf, int width, int height, unsigned frames,
+                  bool shoot);
+  virtual ~CanvasOffscreen();
+
+  // the event loop: draw every frame, with no waiting in between
+  virtual int loop();
+  // repaint what's on the canvas
+  virtual void draw();
+  virtual int get_ms();
+};
+
+#endif  // canvas_offscreen.h
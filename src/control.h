@@ -8,7 +8,7 @@
 #define RAD_TO_DEG(angle) (angle * 180.0 / M_PI)
 
 // a set of controls for objects and the camera. directly corresponds to
-// OpenGL calls.
+// OpenGL calls (see Renderer::apply_camera).
 class Control {
  public:
   Vec3f pos;
@@ -16,14 +16,6 @@ class Control {
   Vec3f rot_axis;
 
   Control() : rot_angle(0) {}
-  void apply_transform() {
-    glTranslated(pos[0], pos[1], pos[2]);
-    glRotated(rot_angle, rot_axis[0], rot_axis[1], rot_axis[2]);
-#if 0
-	// we don't use this
-	glScaled(scale[0], scale[1], scale[2]);
-#endif
-  }
 };
 
 #endif  // _CONTROL_H
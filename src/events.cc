@@ -0,0 +1,182 @@
+#include "events.h"
+
+#include <algorithm>
+
+#define SLOT_MASK (EVENT_SLOTS - 1)
+
+void EventWheel::clear(double when) {
+  // the nodes stay, so handles from before can't find what comes after
+  free_nodes.clear();
+  for (uint32_t i = nodes.size(); i-- > 0;) {
+    nodes[i].live = false;
+    nodes[i].gen++;
+    free_nodes.push_back(i);
+  }
+  for (int k = 0; k < EVENT_LEVELS; k++) {
+    for (int s = 0; s < EVENT_SLOTS; s++)
+      wheel[k][s].clear();
+  }
+  overflow.clear();
+  ready.clear();
+  unsorted = false;
+  now = when;
+  current = tick(when);
+  seq = 0;
+}
+
+EventHandle EventWheel::add(double when, int kind, int what, Bait* bait) {
+  uint32_t i;
+  if (!free_nodes.empty()) {
+    i = free_nodes.back();
+    free_nodes.pop_back();
+  } else {
+    i = nodes.size();
+    nodes.push_back(Node());
+    nodes[i].gen = 0;
+  }
+
+  Node& n = nodes[i];
+  n.e.when = when;
+  n.e.kind = kind;
+  n.e.what = what;
+  n.e.bait = bait;
+  n.seq = seq++;
+  n.live = true;
+  place(i);
+
+  EventHandle h;
+  h.index = i;
+  h.gen = n.gen;
+  return h;
+}
+
+void EventWheel::cancel(EventHandle h) {
+  // it stays where it is until the wheel gets to it
+  if (h.index < nodes.size() && nodes[h.index].gen == h.gen)
+    nodes[h.index].live = false;
+}
+
+bool EventWheel::pending(EventHandle h) const {
+  return h.index < nodes.size() && nodes[h.index].gen == h.gen &&
+         nodes[h.index].live;
+}
+
+void EventWheel::advance(double when) {
+  if (when > now)
+    now = when;
+
+  // everything in the ticks we turn past is due
+  uint64_t target = tick(now);
+  while (current < target) {
+    vector<uint32_t>& slot = wheel[0][current & SLOT_MASK];
+    for (unsigned k = 0; k < slot.size(); k++)
+      make_ready(slot[k]);
+    slot.clear();
+
+    current++;
+    if ((current & SLOT_MASK) == 0)
+      cascade();
+  }
+
+  // and some of what's in the tick we're in
+  vector<uint32_t>& slot = wheel[0][current & SLOT_MASK];
+  unsigned k = 0;
+  while (k < slot.size()) {
+    uint32_t i = slot[k];
+    if (!nodes[i].live || nodes[i].e.when <= now) {
+      make_ready(i);
+      slot[k] = slot.back();
+      slot.pop_back();
+    } else
+      k++;
+  }
+}
+
+bool EventWheel::pop(Event& e) {
+  if (unsorted)
+    sort_ready();
+  while (!ready.empty()) {
+    uint32_t i = ready.back();
+    ready.pop_back();
+    bool live = nodes[i].live;
+    e = nodes[i].e;
+    release(i);
+    if (live)
+      return true;
+  }
+  return false;
+}
+
+void EventWheel::place(uint32_t i) {
+  const Event& e = nodes[i].e;
+  if (e.when <= now) {
+    ready.push_back(i);
+    unsorted = true;
+    return;
+  }
+
+  // the lowest level whose slots reach that far: the one above it has the
+  // event in the same slot the wheel is at now
+  uint64_t t = tick(e.when);
+  for (int k = 0; k < EVENT_LEVELS; k++) {
+    int above = EVENT_SLOT_BITS * (k + 1);
+    if ((t >> above) == (current >> above)) {
+      wheel[k][(t >> (EVENT_SLOT_BITS * k)) & SLOT_MASK].push_back(i);
+      return;
+    }
+  }
+  overflow.push_back(i);
+}
+
+// true if the wheel has just come to a new slot on level k
+#define NEW_SLOT(k) ((current & ((1ull << (EVENT_SLOT_BITS * (k))) - 1)) == 0)
+
+void EventWheel::cascade() {
+  int top = 1;
+  while (top + 1 < EVENT_LEVELS && NEW_SLOT(top + 1))
+    top++;
+
+  // gather everything first: nothing goes back into a slot we're emptying,
+  // since an event that close to now belongs on a lower level
+  vector<uint32_t> moving;
+  if (NEW_SLOT(EVENT_LEVELS))
+    moving.swap(overflow);
+  for (int k = top; k >= 1; k--) {
+    vector<uint32_t>& slot =
+        wheel[k][(current >> (EVENT_SLOT_BITS * k)) & SLOT_MASK];
+    moving.insert(moving.end(), slot.begin(), slot.end());
+    slot.clear();
+  }
+
+  for (unsigned k = 0; k < moving.size(); k++) {
+    if (nodes[moving[k]].live)
+      place(moving[k]);
+    else
+      release(moving[k]);
+  }
+}
+
+void EventWheel::make_ready(uint32_t i) {
+  if (nodes[i].live) {
+    ready.push_back(i);
+    unsorted = true;
+  } else
+    release(i);
+}
+
+void EventWheel::sort_ready() {
+  // latest first, so the earliest comes off the back
+  const vector<Node>& n = nodes;
+  sort(ready.begin(), ready.end(), [&n](uint32_t a, uint32_t b) {
+    if (n[a].e.when != n[b].e.when)
+      return n[a].e.when > n[b].e.when;
+    return n[a].seq > n[b].seq;
+  });
+  unsorted = false;
+}
+
+void EventWheel::release(uint32_t i) {
+  nodes[i].live = false;
+  nodes[i].gen++;
+  free_nodes.push_back(i);
+}
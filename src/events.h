@@ -0,0 +1,95 @@
+#ifndef _EVENTS_H
+#define _EVENTS_H
+
+#include "main.h"
+
+#include <stdint.h>
+#include <vector>
+
+class Bait;
+
+// kinds of scheduled events
+#define EVENT_SCENE_MODE 0  // start scene.mode_next
+#define EVENT_WIND 1        // turn the wind around
+#define EVENT_BAIT_MODE 2   // start bait->mode_next
+#define EVENT_BAIT_STOP 3   // stop bait mode 'what'
+
+// the wheel turns in ticks this long (seconds)
+#define EVENT_TICK (1.0 / 64)
+// each level of the wheel has 2^EVENT_SLOT_BITS slots
+#define EVENT_SLOT_BITS 6
+#define EVENT_SLOTS (1 << EVENT_SLOT_BITS)
+#define EVENT_LEVELS 4
+
+struct Event {
+  double when;  // scene time it's due
+  int kind;     // EVENT_*
+  int what;     // the mode, for EVENT_BAIT_STOP
+  Bait* bait;   // the bait it's for, if any
+};
+
+// names a scheduled event, so it can be cancelled. events are recycled,
+// so this carries a generation like a TailHandle does.
+struct EventHandle {
+  uint32_t index;
+  uint32_t gen;
+
+  EventHandle() : index(~0u), gen(0) {}
+};
+
+// every pending mode and wind event in the scene, on a hierarchical
+// timing wheel. level 0 has a slot for each of the next EVENT_SLOTS
+// ticks; each level above covers EVENT_SLOTS times as long, and its
+// slots are spread out over the level below as the wheel turns to them.
+// adding and cancelling are O(1), and a step only looks at the slots it
+// turns past, so the cost doesn't grow with the number of events
+// pending.
+class EventWheel {
+ public:
+  EventWheel() : unsorted(false), now(0.), current(0), seq(0) {}
+
+  // cancel every event, and start the wheel at time 'when'
+  void clear(double when);
+  // schedule an event at scene time 'when'
+  EventHandle add(double when, int kind, int what = 0, Bait* bait = 0);
+  // unschedule event 'h', if it hasn't happened yet
+  void cancel(EventHandle h);
+  // true if event 'h' is still to come
+  bool pending(EventHandle h) const;
+  // turn the wheel up to scene time 'when'
+  void advance(double when);
+  // take the earliest event due by the last advance(), if there is one
+  bool pop(Event& e);
+
+ private:
+  struct Node {
+    Event e;
+    uint64_t seq;  // breaks ties in 'when', so the order is repeatable
+    uint32_t gen;
+    bool live;     // false once cancelled or popped
+  };
+  vector<Node> nodes;
+  vector<uint32_t> free_nodes;
+
+  vector<uint32_t> wheel[EVENT_LEVELS][EVENT_SLOTS];
+  vector<uint32_t> overflow;  // past the top level
+  vector<uint32_t> ready;     // due, latest first
+  bool unsorted;              // something was added to 'ready' out of order
+
+  double now;        // time of the last advance()
+  uint64_t current;  // every tick before this has been moved to 'ready'
+  uint64_t seq;
+
+  // file node i in the wheel, or in 'ready' if it's due
+  void place(uint32_t i);
+  // spread out the slot the wheel has just come to on each level
+  void cascade();
+  // move node i to 'ready', and hand back the ones that were cancelled
+  void make_ready(uint32_t i);
+  // put 'ready' in order
+  void sort_ready();
+  void release(uint32_t i);
+  static uint64_t tick(double when) { return (uint64_t)(when / EVENT_TICK); }
+};
+
+#endif  // _EVENTS_H
@@ -1,31 +1,32 @@
 #ifndef _PARTICLE_H
 #define _PARTICLE_H
 
-#include "arrow.h"
-#include "tail.h"
-#include "bait.h"
+#include "utils.h"
+
+class Bait;
+class Tail;
+class FlyPool;
+
+// a lightweight handle to one fly in a FlyPool. the fly's state lives in
+// the pool's arrays; this just knows where to find it.
+class Firefly {
+  FlyPool* pool;
+  unsigned i;
 
-class Firefly : public Arrow {
  public:
-  Bait* bait;  // the bait I'm after
-  Tail* tail;  // my pretty tail
-  double age;  // how long I've been alive
-
-  // Firefly(
-  //	the bait I'm after,
-  //	where to put me,
-  //	plus/minus this amount)
-  Firefly(Bait* _bait, Vec3f ctr, double spread);
-  virtual ~Firefly();
-
-  // draw me and my tail
-  virtual void draw();
-  // let t seconds elapse
-  virtual void elapse(double t);
-  // calculate acceleration
-  void calc_accel();
-  // change colors based on parameters
-  void set_color();
+  Firefly(FlyPool* _pool, unsigned _i) : pool(_pool), i(_i) {}
+
+  unsigned index() const { return i; }
+
+  Vec3f pos() const;
+  Vec3f velocity() const;
+  rgbColor color() const;
+  double age() const;
+  Bait* bait() const;
+  Tail* tail() const;
+
+  // chase bait 'b' instead, and start my age over
+  void set_bait(unsigned b);
 };
 
 #endif  // Firefly.h
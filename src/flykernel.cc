@@ -0,0 +1,374 @@
+#include "flykernel.h"
+#include "utils.h"
+
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLYKERNEL_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*KernelFn)(const FlyKernelArgs&, unsigned, unsigned);
+typedef void (*ColorKernelFn)(const ColorKernelArgs&, unsigned, unsigned);
+
+static const char* const kernel_names[] = {"scalar", "sse4.1", "avx2"};
+static const KernelFn kernel_fns[] = {fly_kernel_scalar, fly_kernel_sse41,
+                                      fly_kernel_avx2};
+static const ColorKernelFn color_kernel_fns[] = {
+    color_kernel_scalar, color_kernel_sse41, color_kernel_avx2};
+
+static int kernel_which = fly_kernel_best();
+
+void fly_kernel(const FlyKernelArgs& a, unsigned begin, unsigned end) {
+  kernel_fns[kernel_which](a, begin, end);
+}
+
+void color_kernel(const ColorKernelArgs& a, unsigned begin, unsigned end) {
+  color_kernel_fns[kernel_which](a, begin, end);
+}
+
+int fly_kernel_best() {
+#ifdef FLYKERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return FLYKERNEL_AVX2;
+  if (__builtin_cpu_supports("sse4.1"))
+    return FLYKERNEL_SSE41;
+#endif
+  return FLYKERNEL_SCALAR;
+}
+
+int fly_kernel_select(int which) {
+  int best = fly_kernel_best();
+  if (which > best)
+    which = best;
+  if (which < FLYKERNEL_SCALAR)
+    which = FLYKERNEL_SCALAR;
+  kernel_which = which;
+  return which;
+}
+
+const char* fly_kernel_name() {
+  return kernel_names[kernel_which];
+}
+
+// the reference version. the SIMD versions below do exactly these
+// operations in exactly this order, just several flies at a time.
+void fly_kernel_scalar(const FlyKernelArgs& a, unsigned begin, unsigned end) {
+  const BaitTable& b = *a.baits;
+  const float t = a.t;
+
+  for (unsigned i = begin; i < end; i++) {
+    unsigned j = a.bait[i];
+    float fspeed = b.fspeed[j];
+
+    // accelerate straight at the bait
+    float dx = b.x[j] - a.px[i];
+    float dy = b.y[j] - a.py[i];
+    float dz = b.z[j] - a.pz[i];
+    float n2 = dx * dx + dy * dy + dz * dz;
+    float s = (n2 > 0.f) ? b.faccel[j] / sqrtf(n2) : 0.f;
+    float ax = dx * s, ay = dy * s, az = dz * s;
+
+    float vx = a.vx[i] + ax * t;
+    float vy = a.vy[i] + ay * t;
+    float vz = a.vz[i] + az * t;
+    vx = fminf(fmaxf(vx, -fspeed), fspeed);
+    vy = fminf(fmaxf(vy, -fspeed), fspeed);
+    vz = fminf(fmaxf(vz, -fspeed), fspeed);
+
+    a.px[i] += vx * t;
+    a.py[i] += vy * t;
+    a.pz[i] += vz * t;
+    a.vx[i] = vx;
+    a.vy[i] = vy;
+    a.vz[i] = vz;
+    a.ax[i] = ax;
+    a.ay[i] = ay;
+    a.az[i] = az;
+
+    float speed2 = vx * vx + vy * vy + vz * vz;
+    a.hue[i] = 40.f * speed2 / (fspeed * fspeed) - 20.f;
+  }
+}
+
+// [0,1] to a byte, like pack_rgba()
+static inline unsigned char color_byte(float c) {
+  float v = fminf(fmaxf(c * 255.f + 0.5f, 0.f), 255.f);
+  return (unsigned char)v;
+}
+
+// the reference version, in the same order as the SIMD versions below
+void color_kernel_scalar(const ColorKernelArgs& a, unsigned begin,
+                         unsigned end) {
+  const BaitTable& b = *a.baits;
+
+  for (unsigned i = begin; i < end; i++) {
+    unsigned j = a.bait[i];
+    float h6 = wrap_hue(b.hue[j] + a.hue[i]) * (1.f / 60.f);
+    float v = b.val[j];
+    float vs = v * b.sat[j];
+
+    unsigned char* out = (unsigned char*)(a.rgba + i);
+    out[0] = color_byte(hsv_channel(5.f, h6, v, vs));
+    out[1] = color_byte(hsv_channel(3.f, h6, v, vs));
+    out[2] = color_byte(hsv_channel(1.f, h6, v, vs));
+    out[3] = color_byte(b.alpha[j]);
+  }
+}
+
+#ifdef FLYKERNEL_X86
+
+// 4 flies at a time. SSE has no gather, so the bait fields are fetched
+// one lane at a time.
+__attribute__((target("sse4.1"))) void fly_kernel_sse41(const FlyKernelArgs& a,
+                                                        unsigned begin,
+                                                        unsigned end) {
+  const BaitTable& b = *a.baits;
+  const __m128 t = _mm_set1_ps(a.t);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 k40 = _mm_set1_ps(40.f);
+  const __m128 k20 = _mm_set1_ps(20.f);
+  const __m128 sign = _mm_set1_ps(-0.f);
+  unsigned i = begin;
+
+  for (; i + 4 <= end; i += 4) {
+    const unsigned* j = a.bait + i;
+#define GATHER(f) _mm_set_ps(b.f[j[3]], b.f[j[2]], b.f[j[1]], b.f[j[0]])
+    __m128 bx = GATHER(x), by = GATHER(y), bz = GATHER(z);
+    __m128 faccel = GATHER(faccel), fspeed = GATHER(fspeed);
+#undef GATHER
+    __m128 px = _mm_loadu_ps(a.px + i);
+    __m128 py = _mm_loadu_ps(a.py + i);
+    __m128 pz = _mm_loadu_ps(a.pz + i);
+
+    __m128 dx = _mm_sub_ps(bx, px);
+    __m128 dy = _mm_sub_ps(by, py);
+    __m128 dz = _mm_sub_ps(bz, pz);
+    __m128 n2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                           _mm_mul_ps(dz, dz));
+    __m128 s = _mm_div_ps(faccel, _mm_sqrt_ps(n2));
+    s = _mm_blendv_ps(zero, s, _mm_cmpgt_ps(n2, zero));
+    __m128 ax = _mm_mul_ps(dx, s);
+    __m128 ay = _mm_mul_ps(dy, s);
+    __m128 az = _mm_mul_ps(dz, s);
+
+    __m128 lo = _mm_xor_ps(fspeed, sign);
+    __m128 vx = _mm_add_ps(_mm_loadu_ps(a.vx + i), _mm_mul_ps(ax, t));
+    __m128 vy = _mm_add_ps(_mm_loadu_ps(a.vy + i), _mm_mul_ps(ay, t));
+    __m128 vz = _mm_add_ps(_mm_loadu_ps(a.vz + i), _mm_mul_ps(az, t));
+    vx = _mm_min_ps(_mm_max_ps(vx, lo), fspeed);
+    vy = _mm_min_ps(_mm_max_ps(vy, lo), fspeed);
+    vz = _mm_min_ps(_mm_max_ps(vz, lo), fspeed);
+
+    _mm_storeu_ps(a.px + i, _mm_add_ps(px, _mm_mul_ps(vx, t)));
+    _mm_storeu_ps(a.py + i, _mm_add_ps(py, _mm_mul_ps(vy, t)));
+    _mm_storeu_ps(a.pz + i, _mm_add_ps(pz, _mm_mul_ps(vz, t)));
+    _mm_storeu_ps(a.vx + i, vx);
+    _mm_storeu_ps(a.vy + i, vy);
+    _mm_storeu_ps(a.vz + i, vz);
+    _mm_storeu_ps(a.ax + i, ax);
+    _mm_storeu_ps(a.ay + i, ay);
+    _mm_storeu_ps(a.az + i, az);
+
+    __m128 speed2 =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+                   _mm_mul_ps(vz, vz));
+    __m128 hue = _mm_sub_ps(
+        _mm_div_ps(_mm_mul_ps(k40, speed2), _mm_mul_ps(fspeed, fspeed)), k20);
+    _mm_storeu_ps(a.hue + i, hue);
+  }
+
+  fly_kernel_scalar(a, i, end);
+}
+
+// 8 flies at a time, with the bait fields gathered by index.
+__attribute__((target("avx2"))) void fly_kernel_avx2(const FlyKernelArgs& a,
+                                                     unsigned begin,
+                                                     unsigned end) {
+  const BaitTable& b = *a.baits;
+  const __m256 t = _mm256_set1_ps(a.t);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 k40 = _mm256_set1_ps(40.f);
+  const __m256 k20 = _mm256_set1_ps(20.f);
+  const __m256 sign = _mm256_set1_ps(-0.f);
+  unsigned i = begin;
+
+  for (; i + 8 <= end; i += 8) {
+    __m256i j = _mm256_loadu_si256((const __m256i*)(a.bait + i));
+    __m256 bx = _mm256_i32gather_ps(&b.x[0], j, 4);
+    __m256 by = _mm256_i32gather_ps(&b.y[0], j, 4);
+    __m256 bz = _mm256_i32gather_ps(&b.z[0], j, 4);
+    __m256 faccel = _mm256_i32gather_ps(&b.faccel[0], j, 4);
+    __m256 fspeed = _mm256_i32gather_ps(&b.fspeed[0], j, 4);
+    __m256 px = _mm256_loadu_ps(a.px + i);
+    __m256 py = _mm256_loadu_ps(a.py + i);
+    __m256 pz = _mm256_loadu_ps(a.pz + i);
+
+    __m256 dx = _mm256_sub_ps(bx, px);
+    __m256 dy = _mm256_sub_ps(by, py);
+    __m256 dz = _mm256_sub_ps(bz, pz);
+    __m256 n2 =
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                      _mm256_mul_ps(dz, dz));
+    __m256 s = _mm256_div_ps(faccel, _mm256_sqrt_ps(n2));
+    s = _mm256_blendv_ps(zero, s, _mm256_cmp_ps(n2, zero, _CMP_GT_OQ));
+    __m256 ax = _mm256_mul_ps(dx, s);
+    __m256 ay = _mm256_mul_ps(dy, s);
+    __m256 az = _mm256_mul_ps(dz, s);
+
+    __m256 lo = _mm256_xor_ps(fspeed, sign);
+    __m256 vx = _mm256_add_ps(_mm256_loadu_ps(a.vx + i), _mm256_mul_ps(ax, t));
+    __m256 vy = _mm256_add_ps(_mm256_loadu_ps(a.vy + i), _mm256_mul_ps(ay, t));
+    __m256 vz = _mm256_add_ps(_mm256_loadu_ps(a.vz + i), _mm256_mul_ps(az, t));
+    vx = _mm256_min_ps(_mm256_max_ps(vx, lo), fspeed);
+    vy = _mm256_min_ps(_mm256_max_ps(vy, lo), fspeed);
+    vz = _mm256_min_ps(_mm256_max_ps(vz, lo), fspeed);
+
+    _mm256_storeu_ps(a.px + i, _mm256_add_ps(px, _mm256_mul_ps(vx, t)));
+    _mm256_storeu_ps(a.py + i, _mm256_add_ps(py, _mm256_mul_ps(vy, t)));
+    _mm256_storeu_ps(a.pz + i, _mm256_add_ps(pz, _mm256_mul_ps(vz, t)));
+    _mm256_storeu_ps(a.vx + i, vx);
+    _mm256_storeu_ps(a.vy + i, vy);
+    _mm256_storeu_ps(a.vz + i, vz);
+    _mm256_storeu_ps(a.ax + i, ax);
+    _mm256_storeu_ps(a.ay + i, ay);
+    _mm256_storeu_ps(a.az + i, az);
+
+    __m256 speed2 = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)),
+        _mm256_mul_ps(vz, vz));
+    __m256 hue = _mm256_sub_ps(
+        _mm256_div_ps(_mm256_mul_ps(k40, speed2), _mm256_mul_ps(fspeed, fspeed)),
+        k20);
+    _mm256_storeu_ps(a.hue + i, hue);
+  }
+
+  fly_kernel_scalar(a, i, end);
+}
+
+// hsv_channel() and color_byte() on 4 flies at a time
+__attribute__((target("sse4.1"))) static inline __m128i color_byte_sse41(
+    __m128 n, __m128 h6, __m128 v, __m128 vs) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 k4 = _mm_set1_ps(4.f);
+  const __m128 k6 = _mm_set1_ps(6.f);
+  __m128 k = _mm_add_ps(n, h6);
+  k = _mm_blendv_ps(k, _mm_sub_ps(k, k6), _mm_cmpge_ps(k, k6));
+  __m128 w = _mm_min_ps(_mm_min_ps(k, _mm_sub_ps(k4, k)), one);
+  w = _mm_max_ps(w, zero);
+  __m128 c = _mm_sub_ps(v, _mm_mul_ps(vs, w));
+  c = _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(255.f)), _mm_set1_ps(0.5f));
+  c = _mm_min_ps(_mm_max_ps(c, zero), _mm_set1_ps(255.f));
+  return _mm_cvttps_epi32(c);
+}
+
+__attribute__((target("sse4.1"))) void color_kernel_sse41(
+    const ColorKernelArgs& a, unsigned begin, unsigned end) {
+  const BaitTable& b = *a.baits;
+  const __m128 k360 = _mm_set1_ps(360.f);
+  const __m128 inv360 = _mm_set1_ps(1.f / 360.f);
+  const __m128 inv60 = _mm_set1_ps(1.f / 60.f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  unsigned i = begin;
+
+  for (; i + 4 <= end; i += 4) {
+    const unsigned* j = a.bait + i;
+#define GATHER(f) _mm_set_ps(b.f[j[3]], b.f[j[2]], b.f[j[1]], b.f[j[0]])
+    __m128 h = _mm_add_ps(GATHER(hue), _mm_loadu_ps(a.hue + i));
+    __m128 v = GATHER(val), vs = _mm_mul_ps(v, GATHER(sat));
+    __m128 alpha = GATHER(alpha);
+#undef GATHER
+    h = _mm_sub_ps(h, _mm_mul_ps(k360, _mm_floor_ps(_mm_mul_ps(h, inv360))));
+    __m128 h6 = _mm_mul_ps(h, inv60);
+
+    __m128i r = color_byte_sse41(_mm_set1_ps(5.f), h6, v, vs);
+    __m128i g = color_byte_sse41(_mm_set1_ps(3.f), h6, v, vs);
+    __m128i bl = color_byte_sse41(one, h6, v, vs);
+    // the alpha byte is color_byte(alpha), which is the v - vs * w
+    // above with vs = 0
+    __m128i al = color_byte_sse41(zero, zero, alpha, zero);
+    __m128i rgba = _mm_or_si128(
+        _mm_or_si128(r, _mm_slli_epi32(g, 8)),
+        _mm_or_si128(_mm_slli_epi32(bl, 16), _mm_slli_epi32(al, 24)));
+    _mm_storeu_si128((__m128i*)(a.rgba + i), rgba);
+  }
+
+  color_kernel_scalar(a, i, end);
+}
+
+// hsv_channel() and color_byte() on 8 flies at a time
+__attribute__((target("avx2"))) static inline __m256i color_byte_avx2(
+    __m256 n, __m256 h6, __m256 v, __m256 vs) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 k4 = _mm256_set1_ps(4.f);
+  const __m256 k6 = _mm256_set1_ps(6.f);
+  __m256 k = _mm256_add_ps(n, h6);
+  k = _mm256_blendv_ps(k, _mm256_sub_ps(k, k6), _mm256_cmp_ps(k, k6, _CMP_GE_OQ));
+  __m256 w = _mm256_min_ps(_mm256_min_ps(k, _mm256_sub_ps(k4, k)), one);
+  w = _mm256_max_ps(w, zero);
+  __m256 c = _mm256_sub_ps(v, _mm256_mul_ps(vs, w));
+  c = _mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(255.f)),
+                    _mm256_set1_ps(0.5f));
+  c = _mm256_min_ps(_mm256_max_ps(c, zero), _mm256_set1_ps(255.f));
+  return _mm256_cvttps_epi32(c);
+}
+
+__attribute__((target("avx2"))) void color_kernel_avx2(
+    const ColorKernelArgs& a, unsigned begin, unsigned end) {
+  const BaitTable& b = *a.baits;
+  const __m256 k360 = _mm256_set1_ps(360.f);
+  const __m256 inv360 = _mm256_set1_ps(1.f / 360.f);
+  const __m256 inv60 = _mm256_set1_ps(1.f / 60.f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.f);
+  unsigned i = begin;
+
+  for (; i + 8 <= end; i += 8) {
+    __m256i j = _mm256_loadu_si256((const __m256i*)(a.bait + i));
+    __m256 h = _mm256_add_ps(_mm256_i32gather_ps(&b.hue[0], j, 4),
+                             _mm256_loadu_ps(a.hue + i));
+    __m256 v = _mm256_i32gather_ps(&b.val[0], j, 4);
+    __m256 vs = _mm256_mul_ps(v, _mm256_i32gather_ps(&b.sat[0], j, 4));
+    __m256 alpha = _mm256_i32gather_ps(&b.alpha[0], j, 4);
+    h = _mm256_sub_ps(
+        h, _mm256_mul_ps(k360, _mm256_floor_ps(_mm256_mul_ps(h, inv360))));
+    __m256 h6 = _mm256_mul_ps(h, inv60);
+
+    __m256i r = color_byte_avx2(_mm256_set1_ps(5.f), h6, v, vs);
+    __m256i g = color_byte_avx2(_mm256_set1_ps(3.f), h6, v, vs);
+    __m256i bl = color_byte_avx2(one, h6, v, vs);
+    __m256i al = color_byte_avx2(zero, zero, alpha, zero);
+    __m256i rgba = _mm256_or_si256(
+        _mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+        _mm256_or_si256(_mm256_slli_epi32(bl, 16), _mm256_slli_epi32(al, 24)));
+    _mm256_storeu_si256((__m256i*)(a.rgba + i), rgba);
+  }
+
+  color_kernel_scalar(a, i, end);
+}
+
+#else  // !FLYKERNEL_X86
+
+void fly_kernel_sse41(const FlyKernelArgs& a, unsigned begin, unsigned end) {
+  fly_kernel_scalar(a, begin, end);
+}
+
+void fly_kernel_avx2(const FlyKernelArgs& a, unsigned begin, unsigned end) {
+  fly_kernel_scalar(a, begin, end);
+}
+
+void color_kernel_sse41(const ColorKernelArgs& a, unsigned begin,
+                        unsigned end) {
+  color_kernel_scalar(a, begin, end);
+}
+
+void color_kernel_avx2(const ColorKernelArgs& a, unsigned begin,
+                       unsigned end) {
+  color_kernel_scalar(a, begin, end);
+}
+
+#endif  // FLYKERNEL_X86
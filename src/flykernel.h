@@ -0,0 +1,72 @@
+#ifndef _FLYKERNEL_H
+#define _FLYKERNEL_H
+
+#include <stdint.h>
+#include <vector>
+
+// the parts of each bait that the flies chasing it need, one array per
+// field, indexed by bait number
+struct BaitTable {
+  std::vector<float> x, y, z;  // position
+  std::vector<float> faccel;   // acceleration of the flies chasing it
+  std::vector<float> fspeed;   // speed of the flies chasing it
+  std::vector<float> hue, sat, val, alpha;  // color (hue in degrees)
+};
+
+// everything the integration kernel reads and writes. the fly arrays are
+// indexed by fly, the bait table by bait[i].
+struct FlyKernelArgs {
+  float *px, *py, *pz;  // position (in/out)
+  float *vx, *vy, *vz;  // velocity (in/out)
+  float *ax, *ay, *az;  // acceleration (out)
+  float* hue;           // hue shift due to speed (out)
+  const unsigned* bait;
+  const BaitTable* baits;
+  float t;
+};
+
+// advance flies [begin, end) by a.t seconds: accelerate towards the bait,
+// clamp the velocity to the bait's fspeed, move, and compute the hue shift
+// (40 * speed^2 / fspeed^2 - 20) used to color the fly.
+// dispatches to the widest SIMD version the CPU supports.
+void fly_kernel(const FlyKernelArgs& a, unsigned begin, unsigned end);
+
+// the individual versions. they agree with each other to within float
+// rounding (each does a true sqrt and divide, with no fused multiply-adds).
+void fly_kernel_scalar(const FlyKernelArgs& a, unsigned begin, unsigned end);
+void fly_kernel_sse41(const FlyKernelArgs& a, unsigned begin, unsigned end);
+void fly_kernel_avx2(const FlyKernelArgs& a, unsigned begin, unsigned end);
+
+// everything the color kernel reads and writes, indexed like
+// FlyKernelArgs
+struct ColorKernelArgs {
+  const float* hue;  // hue shift due to speed, from fly_kernel()
+  const unsigned* bait;
+  const BaitTable* baits;
+  uint32_t* rgba;  // color (out), as RGBA8 bytes in that order
+};
+
+// color flies [begin, end): their bait's color, with the hue shifted by
+// a.hue[i] and wrapped into [0,360), converted to RGB and packed. the HSV
+// conversion is done without branches (see hsv_to_rgb()), so a whole
+// vector of flies goes through it at once. dispatches like fly_kernel().
+void color_kernel(const ColorKernelArgs& a, unsigned begin, unsigned end);
+
+// the individual versions. these agree exactly.
+void color_kernel_scalar(const ColorKernelArgs& a, unsigned begin,
+                         unsigned end);
+void color_kernel_sse41(const ColorKernelArgs& a, unsigned begin,
+                        unsigned end);
+void color_kernel_avx2(const ColorKernelArgs& a, unsigned begin, unsigned end);
+
+enum { FLYKERNEL_SCALAR, FLYKERNEL_SSE41, FLYKERNEL_AVX2 };
+
+// the best version this CPU supports
+int fly_kernel_best();
+// force fly_kernel() and color_kernel() to use a particular version
+// (clamped to what's supported). returns the version actually selected.
+int fly_kernel_select(int which);
+// name of the version fly_kernel() is using
+const char* fly_kernel_name();
+
+#endif  // _FLYKERNEL_H
@@ -0,0 +1,251 @@
+#include "flypool.h"
+#include "scene.h"
+#include "modes.h"
+
+#include <algorithm>
+
+void FlyPool::reserve(unsigned n) {
+  pos.reserve(n);
+  velocity.reserve(n);
+  accel.reserve(n);
+  color.reserve(n);
+  age.reserve(n);
+  bait.reserve(n);
+  tail.reserve(n);
+  hue.reserve(n);
+  id.reserve(n);
+  member_slot.reserve(n);
+  slot.reserve(n);
+}
+
+unsigned FlyPool::add(unsigned b, Vec3f ctr, double spread) {
+  unsigned i = size();
+  ctr += rand_vec3(-spread, spread);
+
+  pos.push_back(ctr);
+  velocity.push_back(scene.baits[b]->fspeed *
+                     unit_vec(scene.baits[b]->pos - ctr));
+  accel.push_back(Vec3f(0., 0., 0.));
+  color.push_back(0);
+  pack_rgba(rgbColor(0.f, 0.f, 0.f, 1.f), (unsigned char*)&color.back());
+  age.push_back(0.);
+  bait.push_back(b);
+  tail.push_back(scene.tails.alloc());
+  hue.push_back(0.f);
+  id.push_back(next_id++);
+  member_slot.push_back(0);
+  join(i, b);
+
+  uint32_t s;
+  if (!free_slots.empty()) {
+    s = free_slots.back();
+    free_slots.pop_back();
+  } else {
+    s = slot_index.size();
+    slot_index.push_back(0);
+    slot_gen.push_back(0);
+  }
+  slot_index[s] = i;
+  slot.push_back(s);
+
+  return i;
+}
+
+void FlyPool::remove(unsigned i) {
+  leave(i, bait[i]);
+  slot_gen[slot[i]]++;
+  free_slots.push_back(slot[i]);
+
+  // the last fly moves into index i; tell its bait and its handles
+  unsigned last = size() - 1;
+  if (i != last) {
+    scene.baits[bait[last]]->members[member_slot[last]] = i;
+    slot_index[slot[last]] = i;
+  }
+
+  scene.tails[tail[i]].attached = false;
+  scene.dead_tails.push_back(tail[i]);
+
+  pos.swap_remove(i);
+  velocity.swap_remove(i);
+  accel.swap_remove(i);
+  color[i] = color.back();
+  color.pop_back();
+  age[i] = age.back();
+  age.pop_back();
+  bait[i] = bait.back();
+  bait.pop_back();
+  tail[i] = tail.back();
+  tail.pop_back();
+  hue[i] = hue.back();
+  hue.pop_back();
+  id[i] = id.back();
+  id.pop_back();
+  member_slot[i] = member_slot.back();
+  member_slot.pop_back();
+  slot[i] = slot.back();
+  slot.pop_back();
+}
+
+int FlyPool::find(FlyHandle h) const {
+  if (h.slot >= slot_gen.size() || slot_gen[h.slot] != h.gen)
+    return -1;
+  return slot_index[h.slot];
+}
+
+void FlyPool::clear() {
+  while (!empty())
+    remove(size() - 1);
+  // start the ids and slots over, as in a new pool. handles from before
+  // this may find new flies, so they mustn't be kept across it.
+  next_id = 0;
+  slot_index.clear();
+  slot_gen.clear();
+  free_slots.clear();
+}
+
+void FlyPool::set_bait(unsigned i, unsigned b) {
+  leave(i, bait[i]);
+  bait[i] = b;
+  age[i] = 0.;
+  join(i, b);
+}
+
+void FlyPool::join(unsigned i, unsigned b) {
+  vector<unsigned>& members = scene.baits[b]->members;
+  member_slot[i] = members.size();
+  members.push_back(i);
+}
+
+void FlyPool::leave(unsigned i, unsigned b) {
+  vector<unsigned>& members = scene.baits[b]->members;
+  unsigned slot = member_slot[i];
+  members[slot] = members.back();
+  member_slot[members[slot]] = slot;
+  members.pop_back();
+}
+
+// flies per chunk when elapsing in parallel
+#define ELAPSE_GRAIN 1024
+
+void FlyPool::elapse(double t) {
+  TRACE_SCOPE("flies");
+  unsigned n = size();
+  if (n == 0)
+    return;
+
+  unsigned nbaits = scene.baits.size();
+  bait_table.x.resize(nbaits);
+  bait_table.y.resize(nbaits);
+  bait_table.z.resize(nbaits);
+  bait_table.faccel.resize(nbaits);
+  bait_table.fspeed.resize(nbaits);
+  bait_table.hue.resize(nbaits);
+  bait_table.sat.resize(nbaits);
+  bait_table.val.resize(nbaits);
+  bait_table.alpha.resize(nbaits);
+  for (unsigned j = 0; j < nbaits; j++) {
+    Bait* b = scene.baits[j];
+    bait_table.x[j] = b->pos[0];
+    bait_table.y[j] = b->pos[1];
+    bait_table.z[j] = b->pos[2];
+    bait_table.faccel[j] = b->faccel;
+    bait_table.fspeed[j] = b->fspeed;
+    bait_table.hue[j] = b->hsv[0];
+    bait_table.sat[j] = b->hsv[1];
+    bait_table.val[j] = b->hsv[2];
+    bait_table.alpha[j] = b->hsv[3];
+  }
+
+  scene.workers.run(n, ELAPSE_GRAIN, [this, t](unsigned begin, unsigned end) {
+    elapse_range(t, begin, end);
+  });
+
+  // move the flies that switched baits over to their new member lists,
+  // in index order so the lists don't depend on thread timing
+  sort(switched.begin(), switched.end());
+  for (unsigned k = 0; k < switched.size(); k++) {
+    unsigned i = switched[k].first;
+    leave(i, switched[k].second);
+    join(i, bait[i]);
+  }
+  switched.clear();
+}
+
+void FlyPool::elapse_range(double t, unsigned begin, unsigned end) {
+  TRACE_SCOPE("fly chunk");
+  for (unsigned i = begin; i < end; i++) {
+    age[i] += t;
+    pick_bait(i);
+  }
+
+  FlyKernelArgs args;
+  args.px = &pos.x[0];
+  args.py = &pos.y[0];
+  args.pz = &pos.z[0];
+  args.vx = &velocity.x[0];
+  args.vy = &velocity.y[0];
+  args.vz = &velocity.z[0];
+  args.ax = &accel.x[0];
+  args.ay = &accel.y[0];
+  args.az = &accel.z[0];
+  args.hue = &hue[0];
+  args.bait = &bait[0];
+  args.baits = &bait_table;
+  args.t = t;
+  fly_kernel(args, begin, end);
+
+  ColorKernelArgs cargs;
+  cargs.hue = &hue[0];
+  cargs.bait = &bait[0];
+  cargs.baits = &bait_table;
+  cargs.rgba = &color[0];
+  color_kernel(cargs, begin, end);
+}
+
+void FlyPool::elapse_tails(double t) {
+  TRACE_SCOPE("tails");
+  scene.workers.run(size(), ELAPSE_GRAIN,
+                    [this, t](unsigned begin, unsigned end) {
+                      elapse_tails_range(t, begin, end);
+                    });
+}
+
+void FlyPool::elapse_tails_range(double t, unsigned begin, unsigned end) {
+  TRACE_SCOPE("tail chunk");
+  for (unsigned i = begin; i < end; i++) {
+    Tail& tl = scene.tails[tail[i]];
+    tl.elapse(t);
+    tl.add_link(pos.get(i), color[i], scene.baits[bait[i]]->glow);
+  }
+}
+
+void FlyPool::pick_bait(unsigned i) {
+  Vec3f p = pos.get(i);
+
+  Rng rng = Rng::stream(RNG_FLY, id[i], scene.step);
+
+  if (age[i] > 2.0 && rand_int(rng, 0, 60) == 0) {
+    unsigned j, closest_j = 0;
+    double dist, closest_dist = 1e10;
+    for (j = 0; j < scene.baits.size(); j++) {
+      if ((dist = norm(scene.baits[j]->pos - p)) < closest_dist) {
+        closest_dist = dist;
+        closest_j = j;
+      }
+    }
+    dist = norm(scene.baits[bait[i]]->pos - p);
+    if (closest_dist < dist - 1.0) {
+      std::lock_guard<std::mutex> guard(bait_lock);
+      switched.push_back(make_pair(i, bait[i]));
+      bait[i] = closest_j;
+      age[i] = 0.;
+    }
+  } else if (age[i] > 5.0) {
+    Bait* b = scene.baits[bait[i]];
+    if (norm2(b->pos - p) >= 200 * 200 && !(b->bspeed == 0 || b->attractor)) {
+      std::lock_guard<std::mutex> guard(bait_lock);
+      b->mode_next = BMODE_STOP;
+    }
+  }
+}
@@ -0,0 +1,146 @@
+#ifndef _FLYPOOL_H
+#define _FLYPOOL_H
+
+#include "main.h"
+#include "utils.h"
+#include "firefly.h"
+#include "flykernel.h"
+#include "tail.h"
+
+#include <mutex>
+#include <vector>
+
+
+// an array of 3-vectors stored one component per array, so loops over
+// many vectors touch contiguous memory.
+class Vec3Array {
+ public:
+  vector<float> x, y, z;
+
+  Vec3f get(unsigned i) const { return Vec3f(x[i], y[i], z[i]); }
+  void set(unsigned i, const Vec3f& v) {
+    x[i] = v[0];
+    y[i] = v[1];
+    z[i] = v[2];
+  }
+  void push_back(const Vec3f& v) {
+    x.push_back(v[0]);
+    y.push_back(v[1]);
+    z.push_back(v[2]);
+  }
+  // move the last vector into slot i and shrink by one
+  void swap_remove(unsigned i) {
+    x[i] = x.back();
+    y[i] = y.back();
+    z[i] = z.back();
+    pop_back();
+  }
+  void pop_back() {
+    x.pop_back();
+    y.pop_back();
+    z.pop_back();
+  }
+  void reserve(unsigned n) {
+    x.reserve(n);
+    y.reserve(n);
+    z.reserve(n);
+  }
+  void clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+  }
+};
+
+// names a fly across remove()s, which move flies around. like a
+// TailHandle, it carries its slot's generation, so it won't find a later
+// fly that reuses the slot.
+struct FlyHandle {
+  uint32_t slot;
+  uint32_t gen;
+};
+
+// all the fireflies in the scene, stored field-by-field (structure of
+// arrays) so the per-step update streams linearly through memory.
+// individual flies are referred to by index, or through a Firefly handle.
+// removing a fly moves the last fly into its slot, so indices are only
+// stable until the next remove(); hold a FlyHandle to keep track of a fly
+// for longer.
+class FlyPool {
+ public:
+  Vec3Array pos;
+  Vec3Array velocity;
+  Vec3Array accel;
+  vector<uint32_t> color;  // RGBA8, from color_kernel()
+  vector<double> age;     // how long each fly has been alive
+  vector<unsigned> bait;  // index into scene.baits of the bait it chases
+  vector<TailHandle> tail;  // in scene.tails
+  vector<float> hue;  // hue shift due to speed, from the last elapse()
+  vector<unsigned> id;  // unique per fly; keys its random stream
+  vector<unsigned> member_slot;  // where each fly is in its bait's members
+  vector<uint32_t> slot;         // each fly's slot in the handle table
+
+  FlyPool() : next_id(0) {}
+
+  unsigned size() const { return age.size(); }
+  bool empty() const { return age.empty(); }
+  void reserve(unsigned n);
+
+  // add a fly chasing bait 'b', somewhere within 'spread' of 'ctr'.
+  // returns: the new fly's index
+  unsigned add(unsigned b, Vec3f ctr, double spread);
+  // kill fly i. its tail is handed over to scene.dead_tails.
+  void remove(unsigned i);
+  // kill all flies, and start the ids and handles over
+  void clear();
+  // have fly i chase bait 'b' instead, and start its age over
+  void set_bait(unsigned i, unsigned b);
+
+  Firefly operator[](unsigned i) { return Firefly(this, i); }
+
+  // a handle to fly i that stays good while it lives
+  FlyHandle handle(unsigned i) const {
+    FlyHandle h = {slot[i], slot_gen[slot[i]]};
+    return h;
+  }
+  // returns: the index of fly 'h', or -1 if it has died
+  int find(FlyHandle h) const;
+
+  // let t seconds elapse for every fly. the flies are split into chunks
+  // over scene.workers; the baits must already have been elapsed, since
+  // flies read their bait's position.
+  void elapse(double t);
+  // let t seconds elapse for every fly's tail, and give it a new link
+  // where the fly is now. call after elapse().
+  void elapse_tails(double t);
+  // the bait table the last elapse() handed to fly_kernel()
+  const BaitTable& kernel_baits() const { return bait_table; }
+
+ private:
+  unsigned next_id;
+  vector<unsigned> slot_index;  // the index of the fly in each slot
+  vector<uint32_t> slot_gen;    // the generation of each slot's fly
+  vector<uint32_t> free_slots;
+  BaitTable bait_table;  // scratch copy of the baits for fly_kernel()
+  std::mutex bait_lock;  // guards writes to the baits during elapse()
+  // flies that switched baits during elapse(), and the bait each left.
+  // guarded by bait_lock; the member lists catch up after the update.
+  vector<pair<unsigned, unsigned> > switched;
+
+  // add fly i to the members of bait b
+  void join(unsigned i, unsigned b);
+  // take fly i out of the members of bait b
+  void leave(unsigned i, unsigned b);
+
+  // let t seconds elapse for flies [begin, end)
+  void elapse_range(double t, unsigned begin, unsigned end);
+  // let t seconds elapse for the tails of flies [begin, end)
+  void elapse_tails_range(double t, unsigned begin, unsigned end);
+  // maybe switch fly i to a closer bait, or ask its bait to stop
+  void pick_bait(unsigned i);
+
+  FlyPool(const FlyPool&);
+  FlyPool& operator=(const FlyPool&);
+};
+
+#endif  // _FLYPOOL_H
@@ -0,0 +1,307 @@
+#include "gputails.h"
+#include "shader.h"
+
+#include <string.h>
+
+// vertices per segment between two links: two quads across the tail, the
+// left half and the right, of two triangles each
+#define SEGMENT_VERTS 12
+
+// the vertex shader builds the same triangles TailMesh does: three
+// vertices across each link, the edges clear and the middle fading with
+// age, all moved by the wind. segments past the end of a tail collapse
+// to a point outside the view.
+static const char* tails_vertex_src =
+    "#version 330 compatibility\n"
+    "uniform usampler2D links;\n"
+    "uniform sampler2D colors;\n"
+    "uniform sampler2D wind;\n"
+    "uniform int cap;\n"
+    "uniform uint wind_first;\n"
+    "uniform float tail_length, tail_width, glow_width, stretch_factor,\n"
+    "    tail_opaq;\n"
+    "layout(location = 0) in uvec3 tail;  // slot, head, count\n"
+    "out vec4 vcolor;\n"
+    "// which link (0 or 1) and which of its vertices (left, middle,\n"
+    "// right) each vertex of a segment is\n"
+    "const ivec2 corners[12] = ivec2[12](\n"
+    "    ivec2(0, 0), ivec2(0, 1), ivec2(1, 0),\n"
+    "    ivec2(0, 1), ivec2(1, 0), ivec2(1, 1),\n"
+    "    ivec2(0, 1), ivec2(0, 2), ivec2(1, 1),\n"
+    "    ivec2(0, 2), ivec2(1, 1), ivec2(1, 2));\n"
+    "void main() {\n"
+    "  int seg = gl_VertexID / 12;\n"
+    "  if (seg + 1 >= int(tail.z)) {\n"
+    "    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+    "    vcolor = vec4(0.0);\n"
+    "    return;\n"
+    "  }\n"
+    "  ivec2 c = corners[gl_VertexID % 12];\n"
+    "  int k = seg + c.x;\n"
+    "  ivec2 at = ivec2((int(tail.y) + cap - k) % cap, int(tail.x));\n"
+    "  uvec4 l = texelFetch(links, at, 0);\n"
+    "  vec4 color = texelFetch(colors, at, 0);\n"
+    "  vec4 w = texelFetch(wind, ivec2(int(l.w - wind_first), 0), 0);\n"
+    "  vec3 p = uintBitsToFloat(l.xyz) + w.xyz;\n"
+    "  float dx = (color.a > 0.5) ? glow_width : tail_width;\n"
+    "  float age = w.w / tail_length;\n"
+    "  float stretch = stretch_factor * age * age;\n"
+    "  float alpha = clamp(min(0.9 - age, tail_opaq), 0.0, 1.0);\n"
+    "  if (c.y == 0) {\n"
+    "    p.x += -dx + min(stretch, 0.0);\n"
+    "    alpha = 0.0;\n"
+    "  } else if (c.y == 2) {\n"
+    "    p.x += dx + max(stretch, 0.0);\n"
+    "    alpha = 0.0;\n"
+    "  }\n"
+    "  gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.0);\n"
+    "  vcolor = vec4(color.rgb, alpha);\n"
+    "}\n";
+
+static const char* tails_fragment_src =
+    "#version 330 compatibility\n"
+    "in vec4 vcolor;\n"
+    "out vec4 frag;\n"
+    "void main() {\n"
+    "  frag = vcolor;\n"
+    "}\n";
+
+GpuTails::GpuTails()
+    : program(0),
+      vao(0),
+      links_tex(0),
+      colors_tex(0),
+      wind_tex(0),
+      failed(false),
+      max_size(0),
+      cap(0),
+      rows(0),
+      wind_size(0),
+      copied_step(0),
+      copied_slots(0) {}
+
+// a texture for texelFetch(), with nothing in it yet
+static GLuint make_texture() {
+  GLuint tex;
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return tex;
+}
+
+bool GpuTails::init() {
+  if (!GLEW_VERSION_3_3)
+    return false;
+  program = make_program(tails_vertex_src, tails_fragment_src);
+  if (!program)
+    return false;
+
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "links"), 0);
+  glUniform1i(glGetUniformLocation(program, "colors"), 1);
+  glUniform1i(glGetUniformLocation(program, "wind"), 2);
+  glUseProgram(0);
+  u_cap = glGetUniformLocation(program, "cap");
+  u_wind_first = glGetUniformLocation(program, "wind_first");
+  u_tail_length = glGetUniformLocation(program, "tail_length");
+  u_tail_width = glGetUniformLocation(program, "tail_width");
+  u_glow_width = glGetUniformLocation(program, "glow_width");
+  u_stretch_factor = glGetUniformLocation(program, "stretch_factor");
+  u_tail_opaq = glGetUniformLocation(program, "tail_opaq");
+
+  GLint size;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &size);
+  max_size = size;
+
+  glGenVertexArrays(1, &vao);
+  links_tex = make_texture();
+  colors_tex = make_texture();
+  wind_tex = make_texture();
+  return true;
+}
+
+bool GpuTails::draw(Scene& s, StreamBuffer& stream) {
+  if (failed)
+    return false;
+  if (!program && !init()) {
+    failed = true;
+    return false;
+  }
+
+  if (s.tails.slots() > max_size || s.tails.capacity() > max_size)
+    return false;
+
+  // the tails to draw, straight into the stream
+  unsigned most = s.flies.size() + s.dead_tails.size();
+  if (most == 0)
+    return true;
+  size_t offset;
+  TailInstance* out =
+      (TailInstance*)stream.map(most * sizeof(TailInstance), offset);
+  unsigned n = 0;
+  for (unsigned i = 0; i < most; i++) {
+    TailHandle h = (i < s.flies.size()) ? s.flies.tail[i]
+                                        : s.dead_tails[i - s.flies.size()];
+    Tail& tail = s.tails[h];
+    if (tail.size() < 2)  // need at least 2 links
+      continue;
+    TailInstance t;
+    t.slot = h.slot;
+    t.head = tail.newest();
+    t.count = tail.size();
+    out[n++] = t;
+  }
+  stream.unmap();
+  if (n == 0)
+    return true;
+
+  copy_links(s);
+  copy_wind(s);
+
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+  glEnableVertexAttribArray(0);
+  glVertexAttribIPointer(0, 3, GL_UNSIGNED_INT, sizeof(TailInstance),
+                         (const GLvoid*)offset);
+  glVertexAttribDivisor(0, 1);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, links_tex);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, colors_tex);
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, wind_tex);
+
+  glUseProgram(program);
+  glUniform1i(u_cap, cap);
+  glUniform1ui(u_wind_first, (uint32_t)s.wind_first_step);
+  glUniform1f(u_tail_length, s.tail_length);
+  glUniform1f(u_tail_width, s.tail_width);
+  glUniform1f(u_glow_width, s.glow_factor * s.tail_width);
+  glUniform1f(u_stretch_factor, 2 * s.fsize * s.wind[0]);
+  glUniform1f(u_tail_opaq, s.tail_opaq);
+  glDrawArraysInstanced(GL_TRIANGLES, 0, SEGMENT_VERTS * (cap - 1), n);
+  glUseProgram(0);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindVertexArray(0);
+  return true;
+}
+
+// link l, as a texel of links_tex and of colors_tex
+static inline void pack_link(const TailLink& l, uint32_t* link,
+                             uint32_t* color) {
+  float pos[3] = {l.pos[0], l.pos[1], l.pos[2]};
+  memcpy(link, pos, sizeof(pos));
+  link[3] = l.step;
+  unsigned char* c = (unsigned char*)color;
+  c[0] = l.color[0];
+  c[1] = l.color[1];
+  c[2] = l.color[2];
+  c[3] = l.glow ? 255 : 0;
+}
+
+void GpuTails::copy_links(Scene& s) {
+  TRACE_SCOPE("copy links");
+  const TailPool& pool = s.tails;
+  unsigned slots = pool.slots();
+
+  // a new scene, or too far behind to catch up a column at a time
+  bool resize = pool.capacity() != cap || slots > rows;
+  if (resize || slots < copied_slots || s.step < copied_step ||
+      s.step - copied_step >= cap) {
+    if (resize) {
+      cap = pool.capacity();
+      rows = 1;
+      while (rows < slots)
+        rows *= 2;
+      if (rows > max_size)
+        rows = max_size;
+      glBindTexture(GL_TEXTURE_2D, links_tex);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, cap, rows, 0,
+                   GL_RGBA_INTEGER, GL_UNSIGNED_INT, 0);
+      glBindTexture(GL_TEXTURE_2D, colors_tex);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cap, rows, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, 0);
+      glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    copied_slots = 0;
+  } else {
+    // the columns written since the last copy
+    for (uint64_t st = copied_step + 1; st <= s.step; st++)
+      copy_column(s, st % cap, copied_slots);
+  }
+
+  // and all of any slots that are new since then
+  if (slots > copied_slots) {
+    unsigned n = slots - copied_slots;
+    link_data.resize((size_t)n * cap * 4);
+    color_data.resize((size_t)n * cap);
+    for (unsigned r = 0; r < n; r++) {
+      for (unsigned i = 0; i < cap; i++) {
+        size_t t = (size_t)r * cap + i;
+        pack_link(pool.ring(copied_slots + r, i), &link_data[4 * t],
+                  &color_data[t]);
+      }
+    }
+    glBindTexture(GL_TEXTURE_2D, links_tex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, copied_slots, cap, n,
+                    GL_RGBA_INTEGER, GL_UNSIGNED_INT, &link_data[0]);
+    glBindTexture(GL_TEXTURE_2D, colors_tex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, copied_slots, cap, n, GL_RGBA,
+                    GL_UNSIGNED_BYTE, &color_data[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  copied_slots = slots;
+  copied_step = s.step;
+}
+
+void GpuTails::copy_column(Scene& s, unsigned col, unsigned n) {
+  if (n == 0)
+    return;
+  link_data.resize((size_t)n * 4);
+  color_data.resize(n);
+  for (unsigned r = 0; r < n; r++)
+    pack_link(s.tails.ring(r, col), &link_data[4 * r], &color_data[r]);
+
+  glBindTexture(GL_TEXTURE_2D, links_tex);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, col, 0, 1, n, GL_RGBA_INTEGER,
+                  GL_UNSIGNED_INT, &link_data[0]);
+  glBindTexture(GL_TEXTURE_2D, colors_tex);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, col, 0, 1, n, GL_RGBA, GL_UNSIGNED_BYTE,
+                  &color_data[0]);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GpuTails::copy_wind(Scene& s) {
+  const vector<Vec3f>& offsets = s.wind_offsets();
+  unsigned n = offsets.size();
+  if (n > wind_size) {
+    wind_size = 1;
+    while (wind_size < n)
+      wind_size *= 2;
+    glBindTexture(GL_TEXTURE_2D, wind_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, wind_size, 1, 0, GL_RGBA,
+                 GL_FLOAT, 0);
+  }
+
+  wind_data.resize(n * 4);
+  for (unsigned i = 0; i < n; i++) {
+    wind_data[4 * i + 0] = offsets[i][0];
+    wind_data[4 * i + 1] = offsets[i][1];
+    wind_data[4 * i + 2] = offsets[i][2];
+    wind_data[4 * i + 3] = s.wind_age(i);
+  }
+  glBindTexture(GL_TEXTURE_2D, wind_tex);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, 1, GL_RGBA, GL_FLOAT,
+                  &wind_data[0]);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
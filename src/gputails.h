@@ -0,0 +1,68 @@
+#ifndef _GPUTAILS_H
+#define _GPUTAILS_H
+
+#include "main.h"
+#include "scene.h"
+#include "streambuffer.h"
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <vector>
+
+// draws the tails with the mesh built by a vertex shader, from a copy of
+// scene.tails' links kept in textures: a row for each tail slot, and a
+// column for each place in the ring. every attached tail puts its newest
+// link in the same column (see Tail::head), so keeping the copy up to
+// date takes one column per step, and drawing takes a few words per tail
+// (TailInstance), rather than every link of every tail each frame.
+//
+// it matches what TailMesh builds, to within float rounding.
+class GpuTails {
+ public:
+  GpuTails();
+
+  // draw scene s's tails, with the instances streamed through 'stream'.
+  // returns false, having drawn nothing, if the GL can't do it.
+  bool draw(Scene& s, StreamBuffer& stream);
+
+ private:
+  // what draw() needs from each tail
+  struct TailInstance {
+    uint32_t slot;   // its row
+    uint32_t head;   // column of its newest link
+    uint32_t count;  // its links
+  };
+
+  GLuint program;
+  GLuint vao;
+  GLuint links_tex;   // RGBA32UI: each link's position (as float bits), step
+  GLuint colors_tex;  // RGBA8: each link's color, with alpha 1 if it glows
+  GLuint wind_tex;    // RGBA32F: wind_offsets(), and how old each one is
+  bool failed;        // the GL isn't up to it
+
+  // what the textures hold
+  unsigned max_size;       // GL_MAX_TEXTURE_SIZE
+  unsigned cap;            // columns
+  unsigned rows;           // rows (slots) there's room for
+  unsigned wind_size;      // room in wind_tex
+  uint64_t copied_step;    // the step the copy is up to date with
+  unsigned copied_slots;   // the slots it has
+
+  // what's uploaded each frame
+  vector<uint32_t> link_data;
+  vector<uint32_t> color_data;
+  vector<float> wind_data;
+
+  // uniform locations
+  GLint u_cap, u_wind_first, u_tail_length, u_tail_width, u_glow_width,
+      u_stretch_factor, u_tail_opaq;
+
+  bool init();
+  // bring the copy of the links up to date
+  void copy_links(Scene& s);
+  // copy column 'col' of every slot up to 'n'
+  void copy_column(Scene& s, unsigned col, unsigned n);
+  void copy_wind(Scene& s);
+};
+
+#endif  // _GPUTAILS_H
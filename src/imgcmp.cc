@@ -0,0 +1,54 @@
+// imgcmp: compare two PNGs of the same size, for `make check`. they match
+// if almost every pixel is within a few levels of the other's, which
+// leaves room for GL drivers to rasterize edges a little differently.
+
+#include "lodepng.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// how far a channel may be off before the pixel counts as different
+#define IMGCMP_LEVELS 8
+// the share of pixels that may be different
+#define IMGCMP_PIXELS 0.001
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s a.png b.png\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<unsigned char> a, b;
+  unsigned aw, ah, bw, bh;
+  for (int i = 1; i <= 2; i++) {
+    unsigned error = lodepng::decode(i == 1 ? a : b, i == 1 ? aw : bw,
+                                     i == 1 ? ah : bh, argv[i]);
+    if (error) {
+      fprintf(stderr, "%s: %s\n", argv[i], lodepng_error_text(error));
+      return 2;
+    }
+  }
+  if (aw != bw || ah != bh) {
+    fprintf(stderr, "%s is %ux%u but %s is %ux%u\n", argv[1], aw, ah,
+            argv[2], bw, bh);
+    return 1;
+  }
+
+  size_t pixels = (size_t)aw * ah, differ = 0;
+  int worst = 0;
+  for (size_t i = 0; i < pixels; i++) {
+    int d = 0;
+    for (int c = 0; c < 4; c++)
+      d = std::max(d, abs(a[4 * i + c] - b[4 * i + c]));
+    if (d > IMGCMP_LEVELS)
+      differ++;
+    worst = std::max(worst, d);
+  }
+
+  bool ok = differ <= pixels * IMGCMP_PIXELS;
+  printf("%s vs %s: %zu of %zu pixels differ (most by %d)%s\n", argv[1],
+         argv[2], differ, pixels, worst, ok ? "" : ": FAILED");
+  return ok ? 0 : 1;
+}
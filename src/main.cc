@@ -8,8 +8,12 @@
 #ifdef HAVE_GLUT
 #include "canvas_glut.h"
 #endif
+#ifdef HAVE_EGL
+#include "canvas_offscreen.h"
+#endif
 
 #include <iostream>
+#include <stdio.h>
 #include <stdlib.h>
 
 #ifdef WIN32
@@ -21,10 +25,22 @@
 CanvasBase* canvas;
 Scene scene;
 
-static enum { CANVAS_GLX, CANVAS_GLUT } canvas_type = CANVAS_GLUT;
+static enum {
+  CANVAS_GLX,
+  CANVAS_GLUT,
+  CANVAS_OFFSCREEN
+} canvas_type = CANVAS_GLUT;
 int window_id = 0;
 int mspf = 1000 / 30;
 bool full_screen = false;
+int width = 1280;  // of the offscreen canvas
+int height = 720;
+unsigned frames = 300;
+const char* record_to = 0;
+int shot_width = 7200;
+int shot_height = 4800;
+bool shoot = false;
+bool instancing = true;
 
 #ifdef WIN32
 // mingw doesn't have argp. implement half-assed version
@@ -179,6 +195,17 @@ int argp_parse(struct argp* argp_s, int argc, char* argv[], int, int*, void*) {
 #define OPT_FULLSCREEN 1
 #define OPT_FPS 2
 #define OPT_FASTFORWARD 3
+#define OPT_THREADS 4
+#define OPT_SEED 5
+#define OPT_GPUTAILS 6
+#define OPT_OFFSCREEN 7
+#define OPT_WIDTH 8
+#define OPT_HEIGHT 9
+#define OPT_FRAMES 10
+#define OPT_RECORD 11
+#define OPT_SHOTSIZE 12
+#define OPT_SHOOT 13
+#define OPT_NOINSTANCING 14
 
 const char* const mode_help =
     "\n"
@@ -212,9 +239,30 @@ static struct argp_option options[] = {
     {"root", 'r', 0, 0, "Draw on the root window"},
 
     {"fullscreen", OPT_FULLSCREEN, 0, 0, "Full screen mode"},
+    {"offscreen", OPT_OFFSCREEN, 0, 0,
+     "Draw with no window or X server, as fast as possible, and print the "
+     "time taken"},
+    {"width", OPT_WIDTH, "NUM", 0, "Width to draw offscreen (default = 1280)"},
+    {"height", OPT_HEIGHT, "NUM", 0,
+     "Height to draw offscreen (default = 720)"},
+    {"frames", OPT_FRAMES, "NUM", 0,
+     "Frames to draw offscreen, 0 = until killed (default = 300)"},
+    {"record", OPT_RECORD, "TARGET", 0,
+     "Record every frame, stepping a steady 1/fps each: to a PNG sequence "
+     "(frame%05d.png), a .y4m or .rgba file, Y4M on stdout (-), or RGBA "
+     "piped to a command (\"|command\")"},
+    {"shotsize", OPT_SHOTSIZE, "WxH", 0,
+     "Size of the screenshots 's' takes, which can be any size "
+     "(default = 7200x4800)"},
+    {"shoot", OPT_SHOOT, 0, 0,
+     "Take a screenshot after the last frame drawn offscreen"},
     {"fps", OPT_FPS, "NUM", 0, "Frames per second (default = 30 fps)"},
     {"fastforward", OPT_FASTFORWARD, "NUM", 0,
      "Fast forward factor (default = 1)"},
+    {"threads", OPT_THREADS, "NUM", 0,
+     "Simulation threads, 0 = one per CPU (default = 1)"},
+    {"seed", OPT_SEED, "NUM", 0,
+     "Random seed, for repeatable runs (default = from the clock)"},
     {"minbaits", 'b', "NUM", 0, "Minimum baits (default = 2)"},
     {"maxbaits", 'B', "NUM", 0, "Maximum baits (default = 5)"},
     {"minflies", 'f', "NUM", 0, "Minimum total fireflies (default = 100)"},
@@ -233,6 +281,11 @@ static struct argp_option options[] = {
      "Factor by which tailwidth increases during glow (default = 20)"},
     {"wind", 'w', "NUM", 0, "Wind speed (default = 30)"},
     {"drawbait", 'd', 0, 0, "Draw the baits that the fireflies chase"},
+    {"gputails", OPT_GPUTAILS, 0, 0,
+     "Build the tails on the GPU from a history of the flies' positions "
+     "(needs OpenGL 3.3)"},
+    {"noinstancing", OPT_NOINSTANCING, 0, 0,
+     "Draw the arrows without instancing, as on GL older than 3.3"},
     {"modeswarm", 'm', "MODENUM VAL", 0,
      "Change the frequency of per-swarm mode MODENUM to VAL"},
     {"modemajor", 'M', "MODENUM VAL", 0,
@@ -252,6 +305,39 @@ int parse_opt(int key, char* arg, struct argp_state* state) {
     case OPT_FULLSCREEN:
       full_screen = true;
       break;
+    case OPT_OFFSCREEN:
+      canvas_type = CANVAS_OFFSCREEN;
+      break;
+    case OPT_WIDTH:
+      width = atoi(arg);
+      if (width <= 0) {
+        cerr << state->name << ": -width must be > 0" << endl;
+        return -1;
+      }
+      break;
+    case OPT_HEIGHT:
+      height = atoi(arg);
+      if (height <= 0) {
+        cerr << state->name << ": -height must be > 0" << endl;
+        return -1;
+      }
+      break;
+    case OPT_FRAMES:
+      frames = (unsigned)atoi(arg);
+      break;
+    case OPT_RECORD:
+      record_to = arg;
+      break;
+    case OPT_SHOOT:
+      shoot = true;
+      break;
+    case OPT_SHOTSIZE:
+      if (sscanf(arg, "%dx%d", &shot_width, &shot_height) != 2 ||
+          shot_width <= 0 || shot_height <= 0) {
+        cerr << state->name << ": -shotsize must be like 7200x4800" << endl;
+        return -1;
+      }
+      break;
     case OPT_FPS:
       mspf = 1000 / atoi(arg);
       break;
@@ -262,6 +348,19 @@ int parse_opt(int key, char* arg, struct argp_state* state) {
         return -1;
       }
       break;
+    case OPT_THREADS:
+      scene.threads = (unsigned)atoi(arg);
+      break;
+    case OPT_SEED:
+      scene.seed = strtoull(arg, 0, 0);
+      scene.random_seed = false;
+      break;
+    case OPT_GPUTAILS:
+      scene.gpu_tails = true;
+      break;
+    case OPT_NOINSTANCING:
+      instancing = false;
+      break;
     case 'b':
       scene.minbaits = (unsigned)atoi(arg);
       break;
@@ -355,6 +454,11 @@ static struct argp argp_s = {options, parse_opt, 0, doc};
 int main(int argc, char** argv) {
   if (argp_parse(&argp_s, argc, argv, ARGP_LONG_ONLY, 0, 0) != 0)
     return 0;
+  scene.fps = 1000.0 / mspf;
+
+  // 'kill -USR1' writes out a trace of the last few seconds
+  trace_thread_name("main");
+  trace_catch_signal();
 
   switch (canvas_type) {
     case CANVAS_GLX:
@@ -375,10 +479,25 @@ int main(int argc, char** argv) {
            << ": cannot make GLUT window (you must have GLUT support enabled)"
            << endl;
       return 1;
+#endif
+      break;
+    case CANVAS_OFFSCREEN:
+#ifdef HAVE_EGL
+      canvas =
+          new CanvasOffscreen(&scene, mspf, width, height, frames, shoot);
+#else
+      cerr << argv[0]
+           << ": cannot draw offscreen (you must have EGL support enabled)"
+           << endl;
+      return 1;
 #endif
       break;
   }
 
+  canvas->renderer.instancing = instancing;
+  canvas->record_to = record_to;
+  canvas->shot_width = shot_width;
+  canvas->shot_height = shot_height;
   if (canvas->init() < 0) {
     cerr << "Can't init display." << endl;
     return 0;
@@ -12,7 +12,7 @@
 
 #include "../config.h"
 
-#include <GL/glew.h>
+#include <stdint.h>
 
 using namespace std;
 
@@ -6,8 +6,14 @@
 #define SMODE_WAIT rand_real(10., 20.)
 
 void bait_start_mode(Bait* b, int mode) {
-  b->mode_next = scene.bmodes.rand();
-  b->mode_when = b->age + BMODE_WAIT;
+  bait_start_mode(b, mode, scene.bmodes.rand());
+}
+
+void bait_start_mode(Bait* b, int mode, int next) {
+  b->mode_next = next;
+  scene.events.cancel(b->mode_event);
+  b->mode_event =
+      scene.events.add(scene.curtime + BMODE_WAIT, EVENT_BAIT_MODE, 0, b);
 
   switch (mode) {
     case BMODE_NORMAL:  // normal mode
@@ -27,7 +33,7 @@ void bait_start_mode(Bait* b, int mode) {
           b->bspeed == 0)  // don't do it if we're already doing it
         break;
       b->bspeed = 0;
-      b->stop_timer.add(mode, b->age + rand_real(2., 3.));
+      b->schedule_stop(mode, rand_real(2., 3.));
       break;
     case BMODE_ATTRACTOR:  // attractor
       if (b->attractor ||
@@ -35,36 +41,31 @@ void bait_start_mode(Bait* b, int mode) {
         break;
       b->attractor = new Vec3f(b->pos + rand_vec3(-10, 10));
       b->baccel = (b->bspeed * b->bspeed / 20.0);
-      b->stop_timer.add(mode, b->age + rand_real(5., 10.));
+      b->schedule_stop(mode, rand_real(5., 10.));
       break;
     case BMODE_RAINBOW:  // rainbow mode
       b->hue_rate = rand_int(10, 15) * scene.hue_rate;
-      b->stop_timer.add(mode, b->age + rand_real(10., 15.));
+      b->schedule_stop(mode, rand_real(10., 15.));
       break;
     case BMODE_GLOW:  // glow mode
       b->glow = true;
-      b->stop_timer.add(mode, b->age + rand_real(10., 20.));
+      b->schedule_stop(mode, rand_real(10., 20.));
       break;
     case BMODE_HYPERSPEED:  // hyperspeed mode
       b->bspeed = 1.5 * scene.bspeed;
       b->baccel = 1.5 * scene.baccel;
       b->fspeed = 2 * scene.fspeed;
       b->faccel = 3 * scene.faccel;
-      b->stop_timer.add(mode, b->age + rand_real(10., 20.));
+      b->schedule_stop(mode, rand_real(10., 20.));
       break;
     case BMODE_FADED:  // faded color mode
       b->hsv[1] = rand_real(0.4, 0.6);
-      b->stop_timer.add(mode, b->age + rand_real(10., 20.));
+      b->schedule_stop(mode, rand_real(10., 20.));
       break;
   }
 
 #ifdef DEBUG
-  cerr << "baitmode=" << mode << " for "
-       << (b->stop_timer.events.empty()
-               ? 0
-               : b->stop_timer.events[0].second - b->age)
-       << "s\tnext=" << b->mode_next << " in " << b->mode_when - b->age << "s"
-       << endl;
+  cerr << "baitmode=" << mode << "\tnext=" << b->mode_next << endl;
 #endif
 }
 
@@ -107,6 +108,7 @@ void bait_stop_mode(Bait* b, int mode) {
 void scene_start_mode(int mode) {
   scene.mode_next = scene.smodes.rand();
   scene.mode_when = scene.curtime + SMODE_WAIT;
+  scene.events.cancel(scene.mode_event);
 
   // negatives keep them off the modelist
   switch (mode) {
@@ -114,10 +116,14 @@ void scene_start_mode(int mode) {
       int bmode = scene.bmodes.rand();
       if (bmode < 0)
         break;
-      for (GLuint i = 0; i < scene.baits.size(); i++) {
-        scene.baits[i]->stop_timer.clear();             // clear out any stops
-        bait_start_mode(scene.baits[i], BMODE_NORMAL);  // set default.
-        bait_start_mode(scene.baits[i], bmode);
+      // every bait's next mode, in one go
+      vector<int> next(scene.baits.size());
+      if (!next.empty())
+        scene.bmodes.rand_n(&next[0], next.size());
+      for (unsigned i = 0; i < scene.baits.size(); i++) {
+        scene.baits[i]->cancel_stops();  // clear out any stops
+        bait_start_mode(scene.baits[i], BMODE_NORMAL, next[i]);  // default
+        bait_start_mode(scene.baits[i], bmode, next[i]);
       }
       break;
     }
@@ -167,19 +173,16 @@ void scene_start_mode(int mode) {
     case SMODE_SWARMSPLIT: {                     // split mode
       if (scene.baits.size() >= scene.maxbaits)  // not too many
         break;
-      Bait* b1 = scene.baits[rand_int(0, scene.baits.size() - 1)];
+      unsigned i1 = rand_int(0, scene.baits.size() - 1);
+      unsigned i2 = scene.baits.size();
       Bait* b2 = new Bait();
-      b2->pos = b1->pos;
+      b2->pos = scene.baits[i1]->pos;
       scene.baits.push_back(b2);
       double fpb = (double)scene.flies.size() / scene.baits.size();
       int n = rand_int((int)(fpb / 4), (int)(fpb / 2));
-      for (GLuint i = 0; i < scene.flies.size() && n > 0; i++) {
-        if (scene.flies[i]->bait == b1) {
-          scene.flies[i]->bait = b2;
-          scene.flies[i]->age = 0.0;
-          n--;
-        }
-      }
+      vector<unsigned>& members = scene.baits[i1]->members;
+      for (; n > 0 && !members.empty(); n--)
+        scene.flies.set_bait(members.back(), i2);
       break;
     }
     case SMODE_SWARMMERGE: {  // merge mode
@@ -187,26 +190,14 @@ void scene_start_mode(int mode) {
         break;
       int i1 = rand_int(0, scene.baits.size() - 1);
       int i2 = rand_other(0, scene.baits.size() - 1, i1);
-      Bait* b1 = scene.baits[i1];
-      Bait* b2 = scene.baits[i2];
-
-      for (GLuint i = 0; i < scene.flies.size(); i++) {
-        if (scene.flies[i]->bait == b2) {
-          scene.flies[i]->bait = b1;
-          scene.flies[i]->age = 0.0;
-        }
-      }
-      vector<Bait*>::iterator it = scene.baits.begin();
-      for (; it != scene.baits.end(); it++) {
-        if ((*it) == b2) {
-          scene.baits.erase(it);
-          break;
-        }
-      }
-      delete b2;
+      scene.rem_bait(i2, i1);
       break;
     }
   }
+  // matrix mode stops the clock, so it watches for its own end
+  if (mode != SMODE_MATRIX)
+    scene.mode_event = scene.events.add(scene.mode_when, EVENT_SCENE_MODE);
+
 #ifdef DEBUG
   cerr << "scenemode=" << mode << ", next=" << scene.mode_next << " in "
        << scene.mode_when - scene.curtime << endl;
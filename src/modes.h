@@ -23,8 +23,11 @@
 
 class Bait;
 
-// force b to start behaving in manner described by "mode"
+// force b to start behaving in manner described by "mode", and pick the
+// mode it moves on to next
 void bait_start_mode(Bait* b, int mode);
+// the same, with the next mode already picked (see RandVar::rand_n())
+void bait_start_mode(Bait* b, int mode, int next);
 // cancel effects of mode "mode" - may cancel other modes too
 void bait_stop_mode(Bait* b, int mode);
 
@@ -0,0 +1,390 @@
+#include "recorder.h"
+#include "trace.h"
+
+#include "lodepng.h"
+
+#include <iostream>
+#include <signal.h>
+#include <string.h>
+
+static bool ends_with(const char* s, const char* end);
+static bool make_pattern(const char* target, string& pattern);
+static void rgba_to_yuv420(const unsigned char* rgba, int width, int height,
+                           unsigned char* yuv);
+
+Recorder::Recorder()
+    : format(-1),
+      width(0),
+      height(0),
+      out(0),
+      piped(false),
+      use_pbos(false),
+      drawn(0),
+      collected(0),
+      nframes(0),
+      max_frames(0),
+      next_write(0),
+      quitting(false),
+      failed(false) {
+  for (int i = 0; i < RECORD_PBOS; i++)
+    pbos[i] = 0;
+}
+
+Recorder::~Recorder() {
+  // with no GL context to read them back, frames still in the pbos are
+  // lost. the encoders can still finish what they have.
+  stop_encoders();
+}
+
+int Recorder::start(const char* target, int w, int h, int mspf) {
+  if (strcmp(target, "-") == 0) {
+    format = RECORD_Y4M;
+    out = stdout;
+#ifndef WIN32
+  } else if (target[0] == '|') {
+    format = RECORD_RGBA;
+    // don't let the command going away kill us: the write fails instead
+    signal(SIGPIPE, SIG_IGN);
+    out = popen(target + 1, "w");
+    piped = true;
+#endif
+  } else if (ends_with(target, ".y4m")) {
+    format = RECORD_Y4M;
+    out = fopen(target, "wb");
+  } else if (ends_with(target, ".rgba")) {
+    format = RECORD_RGBA;
+    out = fopen(target, "wb");
+  } else if (ends_with(target, ".png")) {
+    if (!make_pattern(target, pattern)) {
+      cerr << "Can't record to " << target
+           << ": put at most one %d in the file name" << endl;
+      return -1;
+    }
+    format = RECORD_PNG;
+  } else {
+    cerr << "Can't record to " << target
+         << ": use a .png, .y4m or .rgba file, - or |command" << endl;
+    return -1;
+  }
+  if (format != RECORD_PNG && !out) {
+    cerr << "Can't record to " << target << endl;
+    format = -1;
+    return -1;
+  }
+
+  width = w;
+  height = h;
+  drawn = collected = next_write = 0;
+  failed = quitting = false;
+
+  if (format == RECORD_Y4M) {
+    // C420jpeg is full range BT.601, which is what rgba_to_yuv420 makes
+    fprintf(out, "YUV4MPEG2 W%d H%d F1000:%d Ip A1:1 C420jpeg\n", width,
+            height, mspf);
+  }
+
+  use_pbos = GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object;
+  if (use_pbos) {
+    glGenBuffers(RECORD_PBOS, pbos);
+    for (int i = 0; i < RECORD_PBOS; i++) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+      glBufferData(GL_PIXEL_PACK_BUFFER, 4 * width * height, 0,
+                   GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+
+  // leave a CPU for drawing
+  unsigned n = std::thread::hardware_concurrency();
+  n = n > 1 ? n - 1 : 1;
+  max_frames = n * RECORD_QUEUE_PER_THREAD;
+  for (unsigned i = 0; i < n; i++)
+    encoders.push_back(std::thread(&Recorder::encode, this));
+
+  cerr << "Recording " << width << "x" << height << " to " << target << endl;
+  return 0;
+}
+
+void Recorder::capture(int w, int h) {
+  if (!active())
+    return;
+  TRACE_SCOPE("record");
+  if (w != width || h != height) {
+    cerr << "The size changed from " << width << "x" << height << " to " << w
+         << "x" << h << ": recording stopped" << endl;
+    finish();
+    return;
+  }
+
+  if (!use_pbos) {
+    Frame* f = get_frame();
+    vector<unsigned char> rows(4 * width * height);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &rows[0]);
+    size_t stride = 4 * width;
+    for (int y = 0; y < height; y++)
+      memcpy(&f->pixels[y * stride], &rows[(height - 1 - y) * stride],
+             stride);
+    f->index = collected++;
+    drawn++;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      queue.push_back(f);
+    }
+    queued.notify_one();
+    return;
+  }
+
+  // the oldest pbo is about to be reused: take its frame out first
+  if (drawn - collected == RECORD_PBOS)
+    collect();
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[drawn % RECORD_PBOS]);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  drawn++;
+
+  // don't hold on to a finished frame any longer than we have to
+  if (drawn - collected == RECORD_PBOS)
+    collect();
+}
+
+void Recorder::collect() {
+  TRACE_SCOPE("record collect");
+  Frame* f = get_frame();
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[collected % RECORD_PBOS]);
+  const unsigned char* p =
+      (const unsigned char*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+  if (p) {
+    // GL's rows go bottom to top
+    size_t stride = 4 * width;
+    for (int y = 0; y < height; y++)
+      memcpy(&f->pixels[y * stride], p + (height - 1 - y) * stride, stride);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  f->index = collected++;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queue.push_back(f);
+  }
+  queued.notify_one();
+}
+
+Recorder::Frame* Recorder::get_frame() {
+  std::unique_lock<std::mutex> guard(lock);
+  if (free_frames.empty() && nframes < max_frames) {
+    nframes++;
+    guard.unlock();
+    Frame* f = new Frame;
+    f->pixels.resize(4 * width * height);
+    return f;
+  }
+
+  // the encoders are behind: wait for them, rather than pile up frames
+  if (free_frames.empty()) {
+    TRACE_SCOPE("record wait");
+    freed.wait(guard, [this] { return !free_frames.empty(); });
+  }
+  Frame* f = free_frames.back();
+  free_frames.pop_back();
+  return f;
+}
+
+void Recorder::finish() {
+  if (!active())
+    return;
+  TRACE_SCOPE("record finish");
+  while (collected < drawn)
+    collect();
+  stop_encoders();
+
+  if (use_pbos) {
+    glDeleteBuffers(RECORD_PBOS, pbos);
+    for (int i = 0; i < RECORD_PBOS; i++)
+      pbos[i] = 0;
+  }
+  if (out) {
+    if (piped)
+      pclose(out);
+    else if (out == stdout)
+      fflush(out);
+    else
+      fclose(out);
+  }
+  out = 0;
+  piped = false;
+
+  cerr << "Recorded " << collected << " frames" << endl;
+  format = -1;
+}
+
+void Recorder::stop_encoders() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    quitting = true;
+  }
+  queued.notify_all();
+  for (size_t i = 0; i < encoders.size(); i++)
+    encoders[i].join();
+  encoders.clear();
+
+  for (size_t i = 0; i < free_frames.size(); i++)
+    delete free_frames[i];
+  free_frames.clear();
+  nframes = 0;
+}
+
+void Recorder::encode() {
+  trace_thread_name("recorder");
+  vector<unsigned char> yuv;
+
+  while (true) {
+    Frame* f;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      queued.wait(guard, [this] { return quitting || !queue.empty(); });
+      if (queue.empty())
+        return;
+      f = queue.front();
+      queue.erase(queue.begin());
+    }
+
+    switch (format) {
+      case RECORD_PNG:
+        write_png(f);
+        break;
+      case RECORD_Y4M: {
+        TRACE_SCOPE("record yuv");
+        static const char frame_header[] = "FRAME\n";
+        size_t header = sizeof(frame_header) - 1;
+        size_t chroma = ((width + 1) / 2) * ((height + 1) / 2);
+        yuv.resize(header + width * height + 2 * chroma);
+        memcpy(&yuv[0], frame_header, header);
+        rgba_to_yuv420(&f->pixels[0], width, height, &yuv[header]);
+        write_stream(f, &yuv[0], yuv.size());
+        break;
+      }
+      case RECORD_RGBA:
+        write_stream(f, &f->pixels[0], f->pixels.size());
+        break;
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      free_frames.push_back(f);
+    }
+    freed.notify_one();
+  }
+}
+
+void Recorder::write_png(Frame* f) {
+  TRACE_SCOPE("record png");
+  char filename[1024];
+  snprintf(filename, sizeof(filename), pattern.c_str(), f->index);
+
+  // straight to the file a row at a time, rather than building the whole
+  // PNG in memory first. the frames are opaque, so leave out the alpha.
+  lodepng::StreamEncoder png;
+  png.zlibsettings.windowsize = PNG_WINDOW;
+  vector<unsigned char> rgb(3 * (size_t)width);
+  unsigned error = png.open(filename, width, height, LCT_RGB);
+  for (int y = 0; !error && y < height; y++) {
+    const unsigned char* rgba = &f->pixels[4 * (size_t)width * y];
+    for (int x = 0; x < width; x++)
+      memcpy(&rgb[3 * x], &rgba[4 * x], 3);
+    error = png.add_row(&rgb[0]);
+  }
+  if (!error)
+    error = png.finish();
+  if (error) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!failed)
+      cerr << "Can't write " << filename << ": " << lodepng_error_text(error)
+           << endl;
+    failed = true;
+  }
+}
+
+void Recorder::write_stream(Frame* f, const unsigned char* data,
+                            size_t bytes) {
+  std::unique_lock<std::mutex> guard(lock);
+  turned.wait(guard, [this, f] { return next_write == f->index; });
+
+  // it's our turn, and no one else writes until we move it on
+  if (!failed) {
+    guard.unlock();
+    TRACE_SCOPE("record write");
+    bool ok = fwrite(data, 1, bytes, out) == bytes;
+    guard.lock();
+    if (!ok) {
+      cerr << "Can't write frame " << f->index << ": recording stopped"
+           << endl;
+      failed = true;
+    }
+  }
+  next_write++;
+  guard.unlock();
+  turned.notify_all();
+}
+
+static bool ends_with(const char* s, const char* end) {
+  size_t n = strlen(s), m = strlen(end);
+  return n >= m && strcasecmp(s + n - m, end) == 0;
+}
+
+// turn 'target' into a printf pattern for the frame number. it can have
+// one %d (with a width, like %05d); without one, the number goes before
+// the extension.
+static bool make_pattern(const char* target, string& pattern) {
+  const char* p = strchr(target, '%');
+  if (!p) {
+    pattern = string(target, strlen(target) - 4) + "%05d.png";
+    return true;
+  }
+  const char* q = p + 1;
+  while (*q >= '0' && *q <= '9')
+    q++;
+  if (*q != 'd' || strchr(q, '%'))
+    return false;
+  pattern = string(target, p - target) + "%" + string(p + 1, q - p - 1) + "u" +
+            string(q + 1);
+  return true;
+}
+
+// full range BT.601, in 16.16 fixed point, with each chroma sample the
+// average of a 2x2 block
+static void rgba_to_yuv420(const unsigned char* rgba, int width, int height,
+                           unsigned char* yuv) {
+  unsigned char* py = yuv;
+  unsigned char* pu = yuv + width * height;
+  int cw = (width + 1) / 2, ch = (height + 1) / 2;
+  unsigned char* pv = pu + cw * ch;
+
+  for (int y = 0; y < height; y++) {
+    const unsigned char* p = rgba + 4 * width * y;
+    for (int x = 0; x < width; x++, p += 4)
+      *py++ = (19595 * p[0] + 38470 * p[1] + 7471 * p[2] + 32768) >> 16;
+  }
+
+  for (int cy = 0; cy < ch; cy++) {
+    int y0 = 2 * cy, y1 = y0 + 1 < height ? y0 + 1 : y0;
+    for (int cx = 0; cx < cw; cx++) {
+      int x0 = 2 * cx, x1 = x0 + 1 < width ? x0 + 1 : x0;
+      const unsigned char* a = rgba + 4 * (width * y0 + x0);
+      const unsigned char* b = rgba + 4 * (width * y0 + x1);
+      const unsigned char* c = rgba + 4 * (width * y1 + x0);
+      const unsigned char* d = rgba + 4 * (width * y1 + x1);
+      int r = a[0] + b[0] + c[0] + d[0];
+      int g = a[1] + b[1] + c[1] + d[1];
+      int bl = a[2] + b[2] + c[2] + d[2];
+      // sums of 4, so the shift is 18, and 128 << 18 for the offset.
+      // pure blue or red rounds up to 256.
+      int u = (-11059 * r - 21709 * g + 32768 * bl + (257 << 17)) >> 18;
+      int v = (32768 * r - 27439 * g - 5329 * bl + (257 << 17)) >> 18;
+      *pu++ = u < 255 ? u : 255;
+      *pv++ = v < 255 ? v : 255;
+    }
+  }
+}
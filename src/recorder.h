@@ -0,0 +1,106 @@
+#ifndef _RECORDER_H
+#define _RECORDER_H
+
+#include "main.h"
+
+#include <GL/glew.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// frames read back at once: each is collected RECORD_PBOS - 1 frames
+// after it was drawn, by when the GPU has long since finished it
+#define RECORD_PBOS 3
+// frames waiting to be encoded, per encoder thread, before capture()
+// waits for them to catch up
+#define RECORD_QUEUE_PER_THREAD 2
+
+// what the frames are written as
+#define RECORD_PNG 0   // a numbered PNG file each
+#define RECORD_Y4M 1   // one YUV4MPEG2 stream (4:2:0)
+#define RECORD_RGBA 2  // one stream of raw top-to-bottom RGBA frames
+
+// the LZ77 window PNGs (these and screenshots) are compressed with. on
+// our frames a bigger one takes twice as long and makes no smaller files.
+#define PNG_WINDOW 512
+
+// writes every frame drawn out to a video or image sequence. the frame
+// is read back into a ring of pixel buffer objects, so the GPU carries
+// on without waiting, and handed to a few threads to encode, so
+// encoding doesn't hold up drawing either.
+//
+//   recorder.start("frames/%05d.png", width, height, mspf);
+//   ... draw a frame, then before swapping ...
+//   recorder.capture(width, height);
+//   ...
+//   recorder.finish();
+//
+// the target picks the format: "-" is Y4M to stdout, "|command" is RGBA
+// piped to command, and otherwise it goes by the file extension (.y4m,
+// .rgba, or .png, which is a printf pattern for the frame number).
+// capture() and finish() need the GL context current.
+class Recorder {
+ public:
+  Recorder();
+  ~Recorder();
+
+  // start recording frames of width x height to 'target', to be played
+  // back one every 'mspf' ms. returns -1 (and says why) if it can't.
+  int start(const char* target, int width, int height, int mspf);
+  // true between start() and finish()
+  bool active() const { return format >= 0; }
+  // read back the frame just drawn to the current framebuffer
+  void capture(int width, int height);
+  // write out everything captured, and stop
+  void finish();
+
+ private:
+  struct Frame {
+    unsigned index;
+    vector<unsigned char> pixels;  // RGBA, top row first
+  };
+
+  int format;  // RECORD_*, or -1 if not recording
+  int width, height;
+  string pattern;  // the file name pattern for RECORD_PNG
+  FILE* out;       // the stream for RECORD_Y4M and RECORD_RGBA
+  bool piped;      // 'out' came from popen()
+
+  GLuint pbos[RECORD_PBOS];
+  bool use_pbos;
+  unsigned drawn;      // frames read back so far
+  unsigned collected;  // frames handed to the encoders so far
+
+  vector<std::thread> encoders;
+  std::mutex lock;
+  std::condition_variable queued;  // a frame was queued, or quitting
+  std::condition_variable freed;   // a frame was freed
+  std::condition_variable turned;  // 'next_write' moved on
+  vector<Frame*> queue;            // frames to encode, oldest first
+  vector<Frame*> free_frames;
+  unsigned nframes;                // frames allocated
+  unsigned max_frames;
+  unsigned next_write;             // the frame to write to 'out' next
+  bool quitting;
+  bool failed;                     // a write failed: stop writing
+
+  // copy frame 'collected' out of its pbo and queue it
+  void collect();
+  // a frame to fill, waiting for one if they're all in use
+  Frame* get_frame();
+  // encoder thread main loop
+  void encode();
+  void write_png(Frame* f);
+  // write f (or what it became) to 'out', in frame order
+  void write_stream(Frame* f, const unsigned char* data, size_t bytes);
+  // wait for the encoders to finish the queue, and free the frames
+  void stop_encoders();
+
+  Recorder(const Recorder&);
+  Recorder& operator=(const Recorder&);
+};
+
+#endif  // _RECORDER_H
@@ -0,0 +1,348 @@
+#include "renderer.h"
+#include "shader.h"
+
+#include <GL/glu.h>
+#include <math.h>
+#include <stddef.h>
+
+// the view's vertical field of view (degrees), and near and far planes
+#define FOVY 80.
+#define Z_NEAR 5.
+#define Z_FAR 2000.
+
+void Renderer::resize(int width, int height) {
+  GLfloat aspect = (GLfloat)width / (GLfloat)height;
+
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPerspective(FOVY, aspect, Z_NEAR, Z_FAR);
+
+  scene->resize(width, height);
+
+  // For some reason this needs to be done everytime we resize, otherwise
+  // blending is disabled (and I assume other functions)
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+  glEnable(GL_BLEND);
+  glDisable(GL_DEPTH_TEST);
+}
+
+void Renderer::set_tile(int width, int height, int x, int y, int w, int h) {
+  // the same frustum as gluPerspective() in resize(), cut down
+  double top = Z_NEAR * tan(DEG_TO_RAD(FOVY / 2));
+  double right = top * width / height;
+
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glFrustum(-right + 2 * right * x / width, -right + 2 * right * (x + w) / width,
+            -top + 2 * top * y / height, -top + 2 * top * (y + h) / height,
+            Z_NEAR, Z_FAR);
+}
+
+void Renderer::apply_camera(const Vec3& offset) {
+  const Control& camera = scene->camera;
+
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  glTranslated(-camera.pos[0] + offset[0], -camera.pos[1] + offset[1],
+               -camera.pos[2] + offset[2]);
+  glRotated(camera.rot_angle, camera.rot_axis[0], camera.rot_axis[1],
+            camera.rot_axis[2]);
+}
+
+void Renderer::draw() {
+#if 0
+    glColor4f(0.5f, 0.5f, 0.5f, 1.0f);
+    draw_box(-world, world);
+#endif
+
+  stream->begin_frame();
+
+  // the blending is additive, so the flies and tails can go in any order
+  {
+    TRACE_SCOPE("draw flies");
+    draw_arrows();
+  }
+  {
+    TRACE_SCOPE("draw tails");
+    draw_tails();
+  }
+
+  stream->end_frame();
+}
+
+// the instance for an arrow at 'pos' with basis 'axes'
+static inline void set_arrow(ArrowInstance& a, const Vec3f& pos,
+                             const Vec3f axes[3], uint32_t rgba) {
+  for (int k = 0; k < 3; k++) {
+    a.x[k] = axes[0][k];
+    a.y[k] = axes[1][k];
+    a.z[k] = axes[2][k];
+    a.pos[k] = pos[k];
+  }
+  a.rgba = rgba;
+}
+
+void Renderer::fill_arrows(ArrowInstance* out, unsigned n) {
+  const FlyPool& flies = scene->flies;
+  unsigned nbaits = n - flies.size();
+  for (unsigned i = 0; i < nbaits; i++) {
+    const Bait& b = *scene->baits[i];
+    uint32_t rgba;
+    pack_rgba(b.color, (unsigned char*)&rgba);
+    set_arrow(out[i], b.pos, b.axes, rgba);
+  }
+
+  out += nbaits;
+  Vec3f axes[3];
+  for (unsigned i = 0; i < flies.size(); i++) {
+    Arrow::basis(flies.velocity.get(i), axes);
+    set_arrow(out[i], flies.pos.get(i), axes, flies.color[i]);
+  }
+}
+
+// an arrow is two pyramids on a square base, pointing down +z: the front
+// one 3 * fsize high, the back one 2 * fsize. corners 0 and 1 are their
+// tips and 2-5 go around the base.
+#define ARROW_CORNERS 6
+#define ARROW_TRIANGLES 6
+static const float arrow_corners[ARROW_CORNERS][3] = {
+    {0, 0, 3}, {0, 0, -2}, {1, 0, 0}, {0, -1, 0}, {-1, 0, 0}, {0, 1, 0}};
+static const GLushort arrow_shape[ARROW_TRIANGLES * 3] = {
+    0, 2, 3, 0, 3, 4, 0, 4, 5,  // the front pyramid
+    1, 2, 3, 1, 3, 4, 1, 4, 5,  // the butt pyramid
+};
+
+// arrows drawn per glDrawElements call by draw_arrows_batched(), few
+// enough that a batch's indices fit in a GLushort
+#define ARROW_BATCH 1024
+
+// vertex attributes of the arrow program
+#define ATTR_CORNER 0
+#define ATTR_POS 1
+#define ATTR_X 2  // the instance's basis
+#define ATTR_Y 3
+#define ATTR_Z 4
+#define ATTR_COLOR 5
+
+static const char* arrow_vertex_src =
+    "#version 330 compatibility\n"
+    "layout(location = 0) in vec3 corner;\n"
+    "layout(location = 1) in vec3 pos;\n"
+    "layout(location = 2) in vec3 x;\n"
+    "layout(location = 3) in vec3 y;\n"
+    "layout(location = 4) in vec3 z;\n"
+    "layout(location = 5) in vec4 color;\n"
+    "uniform float size;\n"
+    "out vec4 vcolor;\n"
+    "void main() {\n"
+    "  vec3 p = pos + size * (corner.x * x + corner.y * y + corner.z * z);\n"
+    "  gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.0);\n"
+    "  vcolor = color;\n"
+    "}\n";
+
+static const char* arrow_fragment_src =
+    "#version 330 compatibility\n"
+    "in vec4 vcolor;\n"
+    "out vec4 frag;\n"
+    "void main() {\n"
+    "  frag = vcolor;\n"
+    "}\n";
+
+void Renderer::draw_arrows() {
+  unsigned n = scene->flies.size();
+  if (scene->draw_bait)
+    n += scene->baits.size();
+  if (n == 0)
+    return;
+
+  if (!arrow_program && !arrows_batched)
+    arrows_batched = !instancing || !init_arrows();
+
+  if (arrows_batched) {
+    arrows.resize(n);
+    fill_arrows(&arrows[0], n);
+    draw_arrows_batched();
+  } else {
+    size_t offset;
+    ArrowInstance* out =
+        (ArrowInstance*)stream->map(n * sizeof(ArrowInstance), offset);
+    fill_arrows(out, n);
+    stream->unmap();
+    draw_arrows_instanced(n, offset);
+  }
+}
+
+bool Renderer::init_arrows() {
+  if (!GLEW_VERSION_3_3)
+    return false;
+  arrow_program = make_program(arrow_vertex_src, arrow_fragment_src);
+  if (!arrow_program)
+    return false;
+  arrow_size = glGetUniformLocation(arrow_program, "size");
+
+  // the arrow's triangles, as a plain list
+  float mesh[ARROW_TRIANGLES * 3][3];
+  for (int i = 0; i < ARROW_TRIANGLES * 3; i++) {
+    for (int k = 0; k < 3; k++)
+      mesh[i][k] = arrow_corners[arrow_shape[i]][k];
+  }
+
+  glGenVertexArrays(1, &arrow_vao);
+  glBindVertexArray(arrow_vao);
+
+  glGenBuffers(1, &arrow_mesh);
+  glBindBuffer(GL_ARRAY_BUFFER, arrow_mesh);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(mesh), mesh, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(ATTR_CORNER);
+  glVertexAttribPointer(ATTR_CORNER, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return true;
+}
+
+void Renderer::draw_arrows_instanced(unsigned n, size_t offset) {
+  glBindVertexArray(arrow_vao);
+
+  // the rest step once per arrow, from wherever this frame's are
+  glBindBuffer(GL_ARRAY_BUFFER, stream->buffer());
+#define INSTANCE_ATTR(attr, size, type, norm, field)                 \
+  glEnableVertexAttribArray(attr);                                   \
+  glVertexAttribPointer(                                             \
+      attr, size, type, norm, sizeof(ArrowInstance),                 \
+      (const GLvoid*)(offset + offsetof(ArrowInstance, field)));     \
+  glVertexAttribDivisor(attr, 1)
+  INSTANCE_ATTR(ATTR_POS, 3, GL_FLOAT, GL_FALSE, pos);
+  INSTANCE_ATTR(ATTR_X, 3, GL_FLOAT, GL_FALSE, x);
+  INSTANCE_ATTR(ATTR_Y, 3, GL_FLOAT, GL_FALSE, y);
+  INSTANCE_ATTR(ATTR_Z, 3, GL_FLOAT, GL_FALSE, z);
+  INSTANCE_ATTR(ATTR_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, rgba);
+#undef INSTANCE_ATTR
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glUseProgram(arrow_program);
+  glUniform1f(arrow_size, scene->fsize);
+  glDrawArraysInstanced(GL_TRIANGLES, 0, ARROW_TRIANGLES * 3, n);
+  glUseProgram(0);
+  glBindVertexArray(0);
+}
+
+void Renderer::draw_arrows_batched() {
+  if (arrow_index.empty()) {
+    arrow_index.resize(ARROW_BATCH * ARROW_TRIANGLES * 3);
+    for (unsigned i = 0; i < ARROW_BATCH; i++) {
+      for (unsigned k = 0; k < ARROW_TRIANGLES * 3; k++)
+        arrow_index[i * ARROW_TRIANGLES * 3 + k] =
+            i * ARROW_CORNERS + arrow_shape[k];
+    }
+    arrow_verts.resize(ARROW_BATCH * ARROW_CORNERS * 3);
+    arrow_colors.resize(ARROW_BATCH * ARROW_CORNERS);
+  }
+
+  float fsize = scene->fsize;
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, &arrow_verts[0]);
+  glColorPointer(4, GL_UNSIGNED_BYTE, 0, &arrow_colors[0]);
+
+  for (unsigned begin = 0; begin < arrows.size(); begin += ARROW_BATCH) {
+    unsigned n = min((unsigned)arrows.size() - begin, (unsigned)ARROW_BATCH);
+    for (unsigned i = 0; i < n; i++) {
+      const ArrowInstance& a = arrows[begin + i];
+      float* v = &arrow_verts[i * ARROW_CORNERS * 3];
+      for (int c = 0; c < ARROW_CORNERS; c++) {
+        const float* corner = arrow_corners[c];
+        for (int k = 0; k < 3; k++) {
+          v[c * 3 + k] = a.pos[k] + fsize * (corner[0] * a.x[k] +
+                                             corner[1] * a.y[k] +
+                                             corner[2] * a.z[k]);
+        }
+      }
+      for (int k = 0; k < ARROW_CORNERS; k++)
+        arrow_colors[i * ARROW_CORNERS + k] = a.rgba;
+    }
+    glDrawElements(GL_TRIANGLES, n * ARROW_TRIANGLES * 3, GL_UNSIGNED_SHORT,
+                   &arrow_index[0]);
+  }
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void Renderer::draw_tails() {
+  if (scene->gpu_tails && gpu_tails.draw(*scene, *stream))
+    return;
+
+  tail_mesh.plan(*scene);
+  if (tail_mesh.nindex == 0)
+    return;
+
+  // the vertices, then the indices, straight into the stream
+  size_t vbytes = tail_mesh.nverts * sizeof(TailVertex);
+  size_t ibytes = tail_mesh.nindex * sizeof(uint32_t);
+  size_t offset;
+  char* out = (char*)stream->map(vbytes + ibytes, offset);
+  tail_mesh.fill(*scene, (TailVertex*)out, (uint32_t*)(out + vbytes));
+  stream->unmap();
+  size_t ioffset = offset + vbytes;
+
+  glBindBuffer(GL_ARRAY_BUFFER, stream->buffer());
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream->buffer());
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(3, GL_FLOAT, sizeof(TailVertex),
+                  (const GLvoid*)(offset + offsetof(TailVertex, pos)));
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(TailVertex),
+                 (const GLvoid*)(offset + offsetof(TailVertex, rgba)));
+
+  if (GLEW_VERSION_3_1) {
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(TAIL_RESTART);
+    glDrawElements(GL_TRIANGLE_STRIP, tail_mesh.nindex, GL_UNSIGNED_INT,
+                   (const GLvoid*)ioffset);
+    glDisable(GL_PRIMITIVE_RESTART);
+  } else {
+    unsigned n = tail_mesh.strip_first.size();
+    vector<const GLvoid*> first(n);
+    for (unsigned i = 0; i < n; i++)
+      first[i] = (const GLvoid*)(ioffset +
+                                 tail_mesh.strip_first[i] * sizeof(uint32_t));
+    glMultiDrawElements(GL_TRIANGLE_STRIP,
+                        (const GLsizei*)&tail_mesh.strip_count[0],
+                        GL_UNSIGNED_INT, &first[0], n);
+  }
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void draw_box(const Vec3f& min, const Vec3f& max) {
+  glBegin(GL_LINE_LOOP);
+  glVertex3d(min[0], min[1], min[2]);
+  glVertex3d(min[0], max[1], min[2]);
+  glVertex3d(max[0], max[1], min[2]);
+  glVertex3d(max[0], min[1], min[2]);
+  glEnd();
+
+  glBegin(GL_LINE_LOOP);
+  glVertex3d(min[0], min[1], max[2]);
+  glVertex3d(min[0], max[1], max[2]);
+  glVertex3d(max[0], max[1], max[2]);
+  glVertex3d(max[0], min[1], max[2]);
+  glEnd();
+
+  glBegin(GL_LINES);
+  glVertex3d(min[0], min[1], min[2]);
+  glVertex3d(min[0], min[1], max[2]);
+  glVertex3d(min[0], max[1], min[2]);
+  glVertex3d(min[0], max[1], max[2]);
+  glVertex3d(max[0], max[1], min[2]);
+  glVertex3d(max[0], max[1], max[2]);
+  glVertex3d(max[0], min[1], min[2]);
+  glVertex3d(max[0], min[1], max[2]);
+  glEnd();
+}
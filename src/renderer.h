@@ -0,0 +1,89 @@
+#ifndef _RENDERER_H
+#define _RENDERER_H
+
+#include "main.h"
+#include "scene.h"
+#include "gputails.h"
+#include "streambuffer.h"
+#include "tailmesh.h"
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <vector>
+
+// where and how to draw one arrow: its basis (z points the way the arrow
+// does), where it is and its RGBA8 color
+struct ArrowInstance {
+  float x[3], y[3], z[3];
+  float pos[3];
+  uint32_t rgba;
+};
+
+// draws a Scene with OpenGL. the scene itself knows nothing about GL, so
+// it can be simulated without a display.
+class Renderer {
+ public:
+  Scene* scene;
+  StreamBuffer* stream;  // where the arrows and tails go each frame
+  bool instancing;       // draw the arrows instanced, if the GL can
+
+  Renderer(Scene* s, StreamBuffer* sb)
+      : scene(s),
+        stream(sb),
+        instancing(true),
+        arrow_program(0),
+        arrow_vao(0),
+        arrow_mesh(0),
+        arrows_batched(false) {}
+
+  // set up the projection and GL state for a width x height viewport,
+  // and size the scene's world to match
+  void resize(int width, int height);
+  // after resize(width, height), narrow the projection to the w x h
+  // tile of it at (x, y), counting from the bottom left, to draw a big
+  // picture a piece at a time
+  void set_tile(int width, int height, int x, int y, int w, int h);
+  // apply the camera transformations (translate+rotate)
+  void apply_camera(const Vec3& offset);
+  // draw the scene (CREATE it first!)
+  void draw();
+
+  // draw the baits (if we're drawing those) and flies, instanced if we
+  // can
+  void draw_arrows();
+  // set up the arrow shaders and buffers. returns false if the GL can't
+  // draw instanced.
+  bool init_arrows();
+  // write the n arrows draw_arrows() draws to 'out'
+  void fill_arrows(ArrowInstance* out, unsigned n);
+  // draw n arrows as instances of one mesh, from 'offset' in the stream
+  void draw_arrows_instanced(unsigned n, size_t offset);
+  // draw the 'arrows' with their corners worked out here
+  void draw_arrows_batched();
+  // draw every tail
+  void draw_tails();
+
+ private:
+  GLuint arrow_program;
+  GLint arrow_size;  // the program's "size" uniform
+  GLuint arrow_vao;
+  GLuint arrow_mesh;    // the arrow's triangles, in units of fsize
+  bool arrows_batched;  // no instancing, so use draw_arrows_batched()
+
+  // for draw_arrows_batched(): the baits and flies to draw, and arrow
+  // corners, their colors and the triangles between them for a batch of
+  // ARROW_BATCH arrows
+  vector<ArrowInstance> arrows;
+  vector<float> arrow_verts;
+  vector<uint32_t> arrow_colors;
+  vector<GLushort> arrow_index;
+
+  TailMesh tail_mesh;
+  GpuTails gpu_tails;  // if scene->gpu_tails
+};
+
+// Draw a wireframe axis-aligned box whose opposite corners are given by the
+// points 'min' and 'max'.
+void draw_box(const Vec3f& min, const Vec3f& max);
+
+#endif  // _RENDERER_H
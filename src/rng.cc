@@ -0,0 +1,19 @@
+#include "rng.h"
+
+static uint64_t rng_seed = 0;
+static Rng global_rng(0);
+
+Rng Rng::stream(unsigned kind, uint64_t id, uint64_t step) {
+  uint64_t h = rng_mix(rng_seed ^ kind);
+  h = rng_mix(h ^ id);
+  return Rng(rng_mix(h ^ step));
+}
+
+void rand_seed(uint64_t seed) {
+  rng_seed = rng_mix(seed);
+  global_rng = Rng::stream(RNG_SCENE, 0, 0);
+}
+
+Rng& scene_rng() {
+  return global_rng;
+}
@@ -0,0 +1,45 @@
+#ifndef _RNG_H
+#define _RNG_H
+
+#include <stdint.h>
+
+// kinds of things that own a random stream. with the owner's id and the
+// scene step, these pick out a stream that nothing else draws from.
+#define RNG_SCENE 0
+#define RNG_BAIT 1
+#define RNG_FLY 2
+
+// the SplitMix64 finalizer: a cheap, well-mixed 64-bit hash
+inline uint64_t rng_mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// a counter-based random number stream. draw n is just a hash of the
+// stream's key and n, so a stream needs no shared state: every entity can
+// make its own for each step, and the results don't depend on which
+// thread runs it or in what order.
+class Rng {
+  uint64_t key;
+  uint64_t counter;
+
+ public:
+  explicit Rng(uint64_t _key) : key(_key), counter(0) {}
+
+  // the stream for entity 'id' of kind 'kind' during scene step 'step',
+  // under the seed set with rand_seed()
+  static Rng stream(unsigned kind, uint64_t id, uint64_t step);
+
+  // a uniformly random 64-bit number
+  uint64_t next() { return rng_mix(key + 0x9e3779b97f4a7c15ULL * ++counter); }
+  // a random real in [0, 1)
+  double real() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+// seed every stream, including the scene-wide one
+void rand_seed(uint64_t seed);
+// the scene-wide stream, for things that only happen on the main thread
+Rng& scene_rng();
+
+#endif  // _RNG_H
@@ -1,7 +1,7 @@
 #include "scene.h"
 #include "modes.h"
 
-#include <GL/glu.h>
+#include <chrono>
 
 Vec3f world;
 
@@ -12,16 +12,44 @@ Vec3f world;
 // the CPU load is high and everything slows down
 #define MAX_ELAPSE 0.1
 
-Scene::Scene() : matrix(-1.0) {
+// dead tails per chunk when elapsing in parallel
+#define DEAD_TAIL_GRAIN 256
+
+static double seconds() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+void PhaseTimes::clear() {
+  for (int i = 0; i < NUM_PHASES; i++)
+    secs[i] = 0.;
+  steps = 0;
+  fly_steps = 0;
+}
+
+Scene::Scene()
+    : next_bait_id(0),
+      matrix(-1.0),
+      phase_times(0),
+      offsets_step(~(uint64_t)0) {
   set_defaults();
 }
 
 Scene::~Scene() {
-  GLuint i;
+  workers.stop();
+  clear();
+}
+
+void Scene::clear() {
+  unsigned i;
+  flies.clear();
+  for (i = 0; i < dead_tails.size(); i++)
+    tails.free(dead_tails[i]);
+  dead_tails.clear();
   for (i = 0; i < baits.size(); i++)
     delete baits[i];
-  for (i = 0; i < flies.size(); i++)
-    delete flies[i];
+  baits.clear();
+  next_bait_id = 0;
 }
 
 void Scene::set_defaults() {
@@ -44,6 +72,10 @@ void Scene::set_defaults() {
   smodes.change(SMODE_SWARMS, 5);
 
   fast_forward = 1;
+  fps = 30.;
+  threads = 1;
+  seed = 0;
+  random_seed = true;
   minbaits = 2;
   maxbaits = 5;
   minflies = 100;
@@ -60,13 +92,23 @@ void Scene::set_defaults() {
   glow_factor = 2.;
   wind_speed = 3.;
   draw_bait = false;
+  gpu_tails = false;
 }
 
 void Scene::create() {
-  GLuint i, nbaits, nflies;
+  unsigned i, nbaits, nflies;
+
+  workers.start(threads);
+  rand_seed(seed);
+  // a link lives for tail_length seconds, and we get a new one each step
+  tails.init((unsigned)ceil(tail_length * fps) + 2, maxflies);
 
   curtime = 0.0;
-  wind_when = curtime + WIND_WAIT;
+  step = 0;
+  matrix = -1.0;
+  offsets_step = ~(uint64_t)0;
+  events.clear(curtime);
+  wind_event = events.add(curtime + WIND_WAIT, EVENT_WIND);
   scene_start_mode(-1);  // non-existent, just to initialize
 
   nbaits = (minbaits + maxbaits) / 2;
@@ -91,6 +133,10 @@ void Scene::create() {
         break;
     }
   }
+
+  wind_history.clear();
+  wind_history.push_back(WindSample(curtime, wind));
+  wind_first_step = step;
 }
 
 void Scene::add_flies(unsigned n) {
@@ -104,14 +150,14 @@ void Scene::add_flies(unsigned n) {
   if (groupsize < 10)  // but at least size 10
     groupsize = 10;
   Vec3f where;
-  Bait* b = baits[0];
+  unsigned b = 0;
   flies.reserve(flies.size() + n);
   for (unsigned i = 0; i < n; i++) {
     if ((i % groupsize) == 0) {
       where = OFFSCREEN_VEC3();
-      b = baits[rand_int(0, baits.size() - 1)];
+      b = rand_int(0, baits.size() - 1);
     }
-    flies.push_back(new Firefly(b, where, world[2] / 3));
+    flies.add(b, where, world[2] / 3);
   }
 }
 
@@ -121,25 +167,28 @@ void Scene::rem_flies(unsigned n) {
   if (flies.size() - n <= minflies)
     n = flies.size() - minflies;
 
-  Bait* b = baits[rand_int(0, baits.size() - 1)];
-  vector<Firefly*>::iterator it = flies.begin();
-  while (it != flies.end() && n > 0) {
-    if ((*it)->bait == b) {
-      delete (*it);
-      it = flies.erase(it);
-      n--;
-    } else
-      it++;
+  vector<unsigned>& members = baits[rand_int(0, baits.size() - 1)]->members;
+  for (; n > 0 && !members.empty(); n--)
+    flies.remove(members.back());
+}
+
+void Scene::rem_bait(unsigned i, unsigned heir) {
+  unsigned last = baits.size() - 1;
+  while (!baits[i]->members.empty())
+    flies.set_bait(baits[i]->members.back(), heir);
+
+  // the last bait takes over slot i
+  delete baits[i];
+  baits[i] = baits[last];
+  baits.pop_back();
+  if (i != last) {
+    vector<unsigned>& members = baits[i]->members;
+    for (unsigned j = 0; j < members.size(); j++)
+      flies.bait[members[j]] = i;
   }
 }
 
 void Scene::resize(int width, int height) {
-  GLfloat aspect = (GLfloat)width / (GLfloat)height;
-
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  gluPerspective(80., aspect, 5, 2000);
-
   world[2] = 50.;
   if (width > height) {
     world[1] = 80.;
@@ -149,43 +198,10 @@ void Scene::resize(int width, int height) {
     world[1] = world[0] * (height) / width;
   }
   camera.pos = Vec3f(0., 0., 3 * world[2]);
-
-  // For some reason this needs to be done everytime we resize, otherwise
-  // blending is disabled (and I assume other functions)
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-  glEnable(GL_BLEND);
-  glDisable(GL_DEPTH_TEST);
-}
-
-void Scene::apply_camera(const Vec3& offset) {
-  glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
-  glTranslated(-camera.pos[0] + offset[0], -camera.pos[1] + offset[1],
-               -camera.pos[2] + offset[2]);
-  glRotated(camera.rot_angle, camera.rot_axis[0], camera.rot_axis[1],
-            camera.rot_axis[2]);
-}
-
-void Scene::draw() {
-#if 0
-    glColor4f(0.5f, 0.5f, 0.5f, 1.0f);
-    draw_box(-world, world);
-#endif
-
-  for (GLuint i = 0; i < baits.size(); i++)
-    baits[i]->draw();
-
-  for (GLuint i = 0; i < flies.size(); i++)
-    flies[i]->draw();
-
-  vector<Tail*>::iterator it = dead_tails.begin();
-  for (; it != dead_tails.end(); it++)
-    (*it)->draw();
 }
 
 void Scene::elapse(double t) {
+  TRACE_SCOPE("elapse");
   for (unsigned i = 0; i < fast_forward; i++)
     elapse_once(t);
 }
@@ -211,37 +227,136 @@ void Scene::elapse_once(double t) {
     return;
   }
 
+  double start = phase_times ? seconds() : 0.;
   curtime += t;
-  if (curtime >= mode_when)
-    scene_start_mode(mode_next);
-
-  // the wind, she's a changin!
-  if (curtime >= wind_when) {
-    for (int i = 0; i < 3; i++) {
-      if (rand_int(0, 1) == 0)
-        accel[i] = -accel[i];
+  step++;
+  elapse_modes(t);
+  lap(PHASE_MODES, start);
+
+  // elapse, my children. baits go first, since flies chase their
+  // positions.
+  elapse_baits(t);
+  lap(PHASE_BAITS, start);
+
+  flies.elapse(t);
+  lap(PHASE_FLIES, start);
+
+  flies.elapse_tails(t);
+  lap(PHASE_TAILS, start);
+
+  reap_tails(t);
+  forget_wind(t);
+  lap(PHASE_REAP, start);
+
+  if (phase_times) {
+    phase_times->steps++;
+    phase_times->fly_steps += flies.size();
+  }
+}
+
+void Scene::lap(int phase, double& start) {
+  if (!phase_times)
+    return;
+  double now = seconds();
+  phase_times->secs[phase] += now - start;
+  start = now;
+}
+
+void Scene::elapse_modes(double t) {
+  TRACE_SCOPE("modes");
+  events.advance(curtime);
+  Event e;
+  while (events.pop(e)) {
+    switch (e.kind) {
+      case EVENT_SCENE_MODE:
+        scene_start_mode(mode_next);
+        break;
+      case EVENT_WIND:  // the wind, she's a changin!
+        for (int i = 0; i < 3; i++) {
+          if (rand_int(0, 1) == 0)
+            accel[i] = -accel[i];
+        }
+        // next change based on tail length (so we can see a whole cycle
+        // of prettiness blow one way before it gets tossed another)
+        wind_event = events.add(curtime + WIND_WAIT, EVENT_WIND);
+        break;
+      case EVENT_BAIT_MODE:
+        bait_start_mode(e.bait, e.bait->mode_next);
+        break;
+      case EVENT_BAIT_STOP:
+        bait_stop_mode(e.bait, e.what);
+        break;
     }
-    // next change based on tail length (so we can see a whole cycle of
-    // prettiness blow one way before it gets tossed another)
-    wind_when = curtime + WIND_WAIT;
   }
 
   wind += accel * t;
   clamp_vec(wind, wind_speed);
+  wind_history.push_back(WindSample(curtime, wind));
+}
 
-  // elapse, my children
-  for (GLuint i = 0; i < baits.size(); i++)
+void Scene::elapse_baits(double t) {
+  TRACE_SCOPE("baits");
+  for (unsigned i = 0; i < baits.size(); i++)
     baits[i]->elapse(t);
+}
 
-  for (GLuint i = 0; i < flies.size(); i++)
-    flies[i]->elapse(t);
-
-  vector<Tail*>::iterator it = dead_tails.begin();
-  while (it != dead_tails.end()) {
-    if ((*it)->elapse(t)) {  // he's dead!
-      delete (*it);
-      it = dead_tails.erase(it);
+void Scene::reap_tails(double t) {
+  TRACE_SCOPE("reap tails");
+  // the dead tails only touch themselves, so they can fade in parallel
+  dead.resize(dead_tails.size());
+  workers.run(dead_tails.size(), DEAD_TAIL_GRAIN,
+              [this, t](unsigned begin, unsigned end) {
+                TRACE_SCOPE("dead tail chunk");
+                for (unsigned i = begin; i < end; i++)
+                  dead[i] = tails[dead_tails[i]].elapse(t);
+              });
+
+  // the order doesn't matter, so fill each hole with the last one
+  unsigned i = 0;
+  while (i < dead_tails.size()) {
+    if (dead[i]) {  // he's dead!
+      tails.free(dead_tails[i]);
+      dead_tails[i] = dead_tails.back();
+      dead_tails.pop_back();
+      dead[i] = dead.back();
+      dead.pop_back();
     } else
-      it++;
+      i++;
+  }
+}
+
+void Scene::forget_wind(double t) {
+  // every link still alive was born less than tail_length before the
+  // previous step (see Tail::elapse)
+  double then = curtime - t;
+  while (wind_history.size() > 1 &&
+         then - wind_history.front().time >= tail_length) {
+    wind_history.pop_front();
+    wind_first_step++;
+  }
+}
+
+const vector<Vec3f>& Scene::wind_offsets() {
+  if (offsets_step == step && offsets.size() == wind_history.size())
+    return offsets;
+  offsets_step = step;
+  offsets.resize(wind_history.size());
+
+  // each step, every link gets blown by wind * (age / tail_length)^2, so
+  // a link born at time b has moved sum(wind_k * (time_k - b)^2) / L^2
+  // over the later steps k. with u = curtime - time, that sum expands to
+  //   u_b^2 * sum(wind_k) - 2 u_b * sum(wind_k u_k) + sum(wind_k u_k^2)
+  // and the three sums build up from the newest step backwards.
+  Vec3 sum0(0, 0, 0), sum1(0, 0, 0), sum2(0, 0, 0);
+  double scale = 1.0 / (tail_length * tail_length);
+  for (unsigned i = wind_history.size(); i-- > 0;) {
+    double u = curtime - wind_history[i].time;
+    offsets[i] = scale * (u * u * sum0 - 2 * u * sum1 + sum2);
+
+    Vec3 w = wind_history[i].wind;
+    sum0 += w;
+    sum1 += u * w;
+    sum2 += u * u * w;
   }
+  return offsets;
 }
@@ -5,34 +5,79 @@
 
 #include "control.h"
 #include "bait.h"
-#include "firefly.h"
+#include "events.h"
+#include "flypool.h"
 #include "tail.h"
+#include "trace.h"
+#include "workers.h"
 
 #include <gfx/quat.h>
+#include <deque>
 #include <vector>
 
+// the phases of Scene::elapse_once, for timing
+#define PHASE_MODES 0  // scene and bait mode changes, and the wind
+#define PHASE_BAITS 1
+#define PHASE_FLIES 2
+#define PHASE_TAILS 3  // the tails of living flies
+#define PHASE_REAP 4   // fading out and freeing dead tails
+#define NUM_PHASES 5
+
+// where the time in Scene::elapse_once goes
+struct PhaseTimes {
+  double secs[NUM_PHASES];  // seconds spent in each phase
+  uint64_t steps;           // steps timed
+  uint64_t fly_steps;       // the number of flies, summed over those steps
+
+  PhaseTimes() { clear(); }
+  void clear();
+};
+
 class Scene {
  public:
   vector<Bait*> baits;
-  vector<Firefly*> flies;
-  vector<Tail*> dead_tails;
+  TailPool tails;  // every tail, living or dead, and their links
+  FlyPool flies;
+  vector<TailHandle> dead_tails;  // tails of dead flies, still fading
+  vector<char> dead;   // scratch: which dead tails have finished fading
+  WorkerPool workers;  // threads that elapse the flies and tails
 
   Control camera;     // camera orientation
   double curtime;     // total time the program's been running
+  uint64_t step;      // number of steps elapsed (keys the random streams)
+  unsigned next_bait_id;  // the next new bait's id (see Bait::id)
   Vec3f wind;         // current wind direction
   Vec3f accel;        // wind is changing
-  double wind_when;   // time before next wind change
+  EventWheel events;  // every mode and wind change to come
+  EventHandle wind_event;  // the next wind change
   int mode_next;      // the next mode to activate
   double mode_when;   // next time to activate a mode
+  EventHandle mode_event;  // the same, in events
   double matrix;      // -1 if not active, else a timer for how long
                       // the "matrix" mode has been active
   Vec3f matrix_axis;  // the axis to rotate around matrix-style
+  PhaseTimes* phase_times;  // if set, elapse_once adds up its time here
+
+  // the wind at each recent step, back to the birth of the oldest tail
+  // link. tail links only remember where and when they were born; this
+  // is enough to work out where the wind has blown them since.
+  struct WindSample {
+    double time;  // curtime at this step
+    Vec3f wind;   // the wind during this step
+    WindSample(double _time, const Vec3f& _wind) : time(_time), wind(_wind) {}
+  };
+  deque<WindSample> wind_history;
+  uint64_t wind_first_step;  // the step of wind_history[0]
 
   // options
   RandVar smodes;  // enabled modes for scene
   RandVar bmodes;  // enabled modes for baits
 
   unsigned fast_forward;
+  double fps;        // expected steps per second (sizes the tails)
+  unsigned threads;  // simulation threads (0 = one per CPU)
+  uint64_t seed;     // seed for all the random streams
+  bool random_seed;  // pick the seed from the clock instead
   unsigned minbaits;
   unsigned maxbaits;
   unsigned minflies;
@@ -49,10 +94,15 @@ class Scene {
   double glow_factor;
   double wind_speed;
   bool draw_bait;
+  bool gpu_tails;  // build the tails on the GPU (see GpuTails)
 
   Scene();
   ~Scene();
 
+  // free all the baits, flies and tails, so create() can be called again.
+  // ids start over too, so the next scene draws the same random streams
+  // as it would have in a fresh program.
+  void clear();
   // set default options (called from constructor)
   void set_defaults();
   // create the scene with the following parameters
@@ -62,16 +112,40 @@ class Scene {
   void add_flies(unsigned n);
   // remove 'n' flies from random baits
   void rem_flies(unsigned n);
-  // resize the scene.
+  // remove bait i, and point its flies at bait 'heir' instead
+  void rem_bait(unsigned i, unsigned heir);
+  // size the world to fit a width x height view
   void resize(int width, int height);
-  // apply the camera transformations (translate+rotate)
-  void apply_camera(const Vec3& offset);
-  // draw the scene (CREATE it first!)
-  void draw();
   // animation: let t seconds elapse (fast_forward times)
   void elapse(double t);
   // animation: let t seconds elapse once
   void elapse_once(double t);
+
+  // index into wind_history of step 'born' (the low 32 bits of a step)
+  unsigned wind_index(uint32_t born) const {
+    return (uint32_t)(born - (uint32_t)wind_first_step);
+  }
+  // curtime at step 'born'
+  double wind_time(uint32_t born) const {
+    return wind_history[wind_index(born)].time;
+  }
+  // how long ago wind_history[i] was
+  double wind_age(unsigned i) const { return curtime - wind_history[i].time; }
+  // how far the wind has blown something born during each step in
+  // wind_history, up to now. computed once per step, on first use.
+  const vector<Vec3f>& wind_offsets();
+
+ private:
+  vector<Vec3f> offsets;   // cache for wind_offsets()
+  uint64_t offsets_step;   // the step 'offsets' was computed for
+  // the phases of elapse_once, in order
+  void elapse_modes(double t);
+  void elapse_baits(double t);
+  void reap_tails(double t);
+  // forget the wind from steps no tail link was born in anymore
+  void forget_wind(double t);
+  // if timing, add the time since 'start' to phase 'phase', and restart
+  void lap(int phase, double& start);
 };
 
 extern Vec3f world;
@@ -0,0 +1,54 @@
+#include "shader.h"
+#include "main.h"
+
+#include <iostream>
+#include <vector>
+
+// returns: the shader, or 0 if it doesn't compile
+static GLuint compile(GLenum type, const char* src) {
+  GLuint s = glCreateShader(type);
+  glShaderSource(s, 1, &src, 0);
+  glCompileShader(s);
+
+  GLint ok, len;
+  glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    glGetShaderiv(s, GL_INFO_LOG_LENGTH, &len);
+    vector<char> log(len + 1);
+    glGetShaderInfoLog(s, len, 0, &log[0]);
+    cerr << "shader doesn't compile: " << &log[0] << endl;
+    glDeleteShader(s);
+    return 0;
+  }
+  return s;
+}
+
+GLuint make_program(const char* vertex_src, const char* fragment_src) {
+  GLuint vs = compile(GL_VERTEX_SHADER, vertex_src);
+  GLuint fs = compile(GL_FRAGMENT_SHADER, fragment_src);
+  if (!vs || !fs) {
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    return 0;
+  }
+
+  GLuint p = glCreateProgram();
+  glAttachShader(p, vs);
+  glAttachShader(p, fs);
+  glLinkProgram(p);
+  // the program keeps them alive until it goes
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+
+  GLint ok, len;
+  glGetProgramiv(p, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    glGetProgramiv(p, GL_INFO_LOG_LENGTH, &len);
+    vector<char> log(len + 1);
+    glGetProgramInfoLog(p, len, 0, &log[0]);
+    cerr << "shaders don't link: " << &log[0] << endl;
+    glDeleteProgram(p);
+    return 0;
+  }
+  return p;
+}
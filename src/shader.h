@@ -0,0 +1,10 @@
+#ifndef _SHADER_H
+#define _SHADER_H
+
+#include <GL/glew.h>
+
+// compile a vertex and fragment shader and link them into a program.
+// returns 0, after saying what went wrong on cerr, if they don't build.
+GLuint make_program(const char* vertex_src, const char* fragment_src);
+
+#endif  // _SHADER_H
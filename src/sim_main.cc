@@ -0,0 +1,144 @@
+// fireflies-sim: run the simulation with no display, for testing and
+// timing on machines without a GPU or X server.
+
+#include "main.h"
+#include "scene.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <argp.h>
+
+Scene scene;
+
+static unsigned long steps = 1000;
+static unsigned long report = 100;  // print stats every this many steps
+static int width = 1280;
+static int height = 720;
+static const char* trace_file = 0;
+
+#define OPT_THREADS 1
+#define OPT_SEED 2
+#define OPT_FPS 3
+#define OPT_STEPS 4
+#define OPT_REPORT 5
+#define OPT_WIDTH 6
+#define OPT_HEIGHT 7
+#define OPT_TRACE 8
+
+const char* argp_program_version =
+    "Fireflies " PACKAGE_VERSION " by Mattperry <mpcomplete@gmail.com>";
+
+static char doc[] = "Run the fireflies simulation without drawing anything.";
+
+static struct argp_option options[] = {
+    {"steps", OPT_STEPS, "NUM", 0, "Steps to simulate (default = 1000)"},
+    {"report", OPT_REPORT, "NUM", 0,
+     "Print stats every NUM steps, 0 = only at the end (default = 100)"},
+    {"fps", OPT_FPS, "NUM", 0, "Steps per simulated second (default = 30)"},
+    {"width", OPT_WIDTH, "NUM", 0, "Width of the view to size the world "
+     "for (default = 1280)"},
+    {"height", OPT_HEIGHT, "NUM", 0, "Height of the view (default = 720)"},
+    {"threads", OPT_THREADS, "NUM", 0,
+     "Simulation threads, 0 = one per CPU (default = 1)"},
+    {"seed", OPT_SEED, "NUM", 0, "Random seed (default = 0)"},
+    {"trace", OPT_TRACE, "FILE", 0,
+     "At the end, write a trace of the last steps to FILE"},
+    {"minbaits", 'b', "NUM", 0, "Minimum baits (default = 2)"},
+    {"maxbaits", 'B', "NUM", 0, "Maximum baits (default = 5)"},
+    {"minflies", 'f', "NUM", 0, "Minimum total fireflies (default = 100)"},
+    {"maxflies", 'F', "NUM", 0, "Maximum total fireflies (default = 175)"},
+    {"taillength", 't', "NUM", 0, "Firefly's tail length (default = 23)"},
+    {0, 0, 0, 0}};
+
+static int parse_opt(int key, char* arg, struct argp_state* state) {
+  switch (key) {
+    case OPT_STEPS:
+      steps = strtoul(arg, 0, 0);
+      break;
+    case OPT_REPORT:
+      report = strtoul(arg, 0, 0);
+      break;
+    case OPT_FPS:
+      scene.fps = atoi(arg);
+      if (scene.fps <= 0) {
+        cerr << state->name << ": -fps must be > 0" << endl;
+        return -1;
+      }
+      break;
+    case OPT_WIDTH:
+      width = atoi(arg);
+      break;
+    case OPT_HEIGHT:
+      height = atoi(arg);
+      break;
+    case OPT_THREADS:
+      scene.threads = (unsigned)atoi(arg);
+      break;
+    case OPT_SEED:
+      scene.seed = strtoull(arg, 0, 0);
+      break;
+    case OPT_TRACE:
+      trace_file = arg;
+      break;
+    case 'b':
+      scene.minbaits = (unsigned)atoi(arg);
+      break;
+    case 'B':
+      scene.maxbaits = (unsigned)atoi(arg);
+      break;
+    case 'f':
+      scene.minflies = (unsigned)atoi(arg);
+      break;
+    case 'F':
+      scene.maxflies = (unsigned)atoi(arg);
+      break;
+    case 't':
+      scene.tail_length = atoi(arg) / 10.0;
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+  }
+  return 0;
+}
+
+static struct argp argp_s = {options, parse_opt, 0, doc};
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void print_stats(unsigned long step, double secs) {
+  cout << "step " << step << ": t=" << scene.curtime
+       << "s baits=" << scene.baits.size() << " flies=" << scene.flies.size()
+       << " dead_tails=" << scene.dead_tails.size()
+       << " ms/step=" << (step ? 1000 * secs / step : 0) << endl;
+}
+
+int main(int argc, char** argv) {
+  if (argp_parse(&argp_s, argc, argv, ARGP_LONG_ONLY, 0, 0) != 0)
+    return 1;
+
+  trace_thread_name("main");
+  scene.resize(width, height);
+  scene.create();
+
+  double t = 1.0 / scene.fps;
+  double start = now();
+  for (unsigned long i = 1; i <= steps; i++) {
+    scene.elapse_once(t);
+    if (report && i % report == 0)
+      print_stats(i, now() - start);
+  }
+  if (!report || steps % report != 0)
+    print_stats(steps, now() - start);
+
+  if (trace_file && !trace_dump(trace_file)) {
+    cerr << argv[0] << ": can't write " << trace_file << endl;
+    return 1;
+  }
+
+  return 0;
+}
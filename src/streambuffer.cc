@@ -0,0 +1,118 @@
+#include "streambuffer.h"
+#include "trace.h"
+
+// where each map() starts in a region: enough for any vertex format, and
+// a cache line so two maps don't share one
+#define STREAM_ALIGN 64
+
+// how long to wait on a fence at a time (ns)
+#define FENCE_TIMEOUT 1000000000
+
+StreamBuffer::StreamBuffer()
+    : buf(0),
+      ready(false),
+      mapped(0),
+      region_size(STREAM_REGION_SIZE),
+      region(0),
+      head(0) {
+  for (int r = 0; r < STREAM_FRAMES; r++)
+    fences[r] = 0;
+}
+
+void StreamBuffer::init() {
+  ready = true;
+  glGenBuffers(1, &buf);
+  if (GLEW_ARB_buffer_storage)
+    create();
+}
+
+void StreamBuffer::create() {
+  for (int r = 0; r < STREAM_FRAMES; r++) {
+    if (fences[r]) {
+      glDeleteSync(fences[r]);
+      fences[r] = 0;
+    }
+  }
+
+  // buffer storage is immutable, so growing takes a new buffer. anything
+  // still drawing from the old one keeps it alive until it's done.
+  if (mapped) {
+    glBindBuffer(GL_ARRAY_BUFFER, buf);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDeleteBuffers(1, &buf);
+    glGenBuffers(1, &buf);
+    mapped = 0;
+  }
+
+  GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  GLsizeiptr size = region_size * STREAM_FRAMES;
+  glBindBuffer(GL_ARRAY_BUFFER, buf);
+  glBufferStorage(GL_ARRAY_BUFFER, size, 0, flags);
+  mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StreamBuffer::begin_frame() {
+  if (!ready)
+    init();
+  region = (region + 1) % STREAM_FRAMES;
+  head = 0;
+  if (mapped)
+    wait(region);
+}
+
+void StreamBuffer::end_frame() {
+  if (mapped)
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::wait(unsigned r) {
+  if (!fences[r])
+    return;
+  TRACE_SCOPE("stream wait");
+  while (glClientWaitSync(fences[r], GL_SYNC_FLUSH_COMMANDS_BIT,
+                          FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED)
+    ;
+  glDeleteSync(fences[r]);
+  fences[r] = 0;
+}
+
+void* StreamBuffer::map(size_t bytes, size_t& offset) {
+  if (!ready)
+    init();
+
+  if (!mapped) {
+    staging.resize(bytes);
+    offset = 0;
+    return &staging[0];
+  }
+
+  size_t start = (head + STREAM_ALIGN - 1) & ~(size_t)(STREAM_ALIGN - 1);
+  if (start + bytes > region_size) {
+    grow(start + bytes);
+    start = 0;
+  }
+  head = start + bytes;
+  offset = region * region_size + start;
+  return mapped + offset;
+}
+
+void StreamBuffer::unmap() {
+  if (mapped)
+    return;  // coherent, so the GPU sees the writes as they happen
+
+  // orphan the old storage and upload into new, so we don't wait for
+  // anything still drawing from it
+  glBindBuffer(GL_ARRAY_BUFFER, buf);
+  glBufferData(GL_ARRAY_BUFFER, staging.size(), &staging[0], GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StreamBuffer::grow(size_t bytes) {
+  while (region_size < bytes)
+    region_size *= 2;
+  create();
+  head = 0;
+}
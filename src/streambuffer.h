@@ -0,0 +1,76 @@
+#ifndef _STREAMBUFFER_H
+#define _STREAMBUFFER_H
+
+#include "main.h"
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <vector>
+
+// regions of the buffer in flight at once: one being written, and up to
+// two more the GPU may still be drawing from
+#define STREAM_FRAMES 3
+// what each region starts out holding; they grow as needed
+#define STREAM_REGION_SIZE (1 << 20)
+
+// a vertex buffer for data that's written fresh every frame. with
+// GL_ARB_buffer_storage it's mapped once, persistently, and split into
+// STREAM_FRAMES regions used in turn, each guarded by a fence, so meshes
+// are written straight into memory the GPU reads from without copying or
+// waiting. without the extension, each map() hands out a staging buffer
+// which unmap() uploads into freshly orphaned storage.
+//
+//   stream.begin_frame();
+//   size_t offset;
+//   Vertex* v = (Vertex*)stream.map(n * sizeof(Vertex), offset);
+//   ... fill in v[0..n) ...
+//   stream.unmap();
+//   glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+//   ... draw from 'offset' ...
+//   stream.end_frame();
+//
+// map() may have to move everything to a bigger buffer, so draw what one
+// map() returned before the next, and bind buffer() after mapping. only
+// use it with its GL context current.
+class StreamBuffer {
+ public:
+  StreamBuffer();
+
+  // start a frame, waiting for the GPU to finish with the region it's
+  // going to write, if it hasn't already
+  void begin_frame();
+  // fence off what this frame wrote
+  void end_frame();
+
+  // room for 'bytes' to write this frame. returns where to write them,
+  // and their 'offset' in buffer() to draw them from. the memory is
+  // write-only: don't read it back.
+  void* map(size_t bytes, size_t& offset);
+  // done writing what map() returned: it can be drawn now
+  void unmap();
+
+  // the GL buffer to draw from
+  GLuint buffer() const { return buf; }
+  // true if it's persistently mapped
+  bool persistent() const { return mapped != 0; }
+
+ private:
+  GLuint buf;
+  bool ready;            // buf has been set up
+  char* mapped;          // all of buf, if it's persistently mapped
+  size_t region_size;    // bytes in each region
+  unsigned region;       // the region this frame writes
+  size_t head;           // next free byte in this frame's region
+  GLsync fences[STREAM_FRAMES];
+  vector<char> staging;  // what map() handed out, without persistence
+
+  void init();
+  // make the regions hold at least 'bytes' each
+  void grow(size_t bytes);
+  // (re)make buf with the current region_size
+  void create();
+  // wait for region r to be done with, and forget its fence
+  void wait(unsigned r);
+};
+
+#endif  // _STREAMBUFFER_H
@@ -1,84 +1,78 @@
 #include "tail.h"
-#include "firefly.h"
 #include "scene.h"
 
-Tail::Tail(Firefly* _owner) : owner(_owner) {}
-
-#define SET_COLOR(c, a) glColor4f(c[0], c[1], c[2], a)
-#define SET_VERTEX(v, dx) glVertex3d(v[0] + dx, v[1], v[2])
-#define DO_POINT(t, dx, a) \
-  SET_COLOR((t).color, a); \
-  SET_VERTEX((t).pos, dx)
-
-void Tail::draw() {
-  if (links.size() < 2)  // need at least 2 links
-    return;
-
-  deque<Link>::iterator it = links.begin();
-  double glow_width = scene.glow_factor * scene.tail_width;
-  double stretch_factor = 2 * scene.fsize * scene.wind[0];
-  double dx1, dx2;
-
-  dx2 = ((*it).glow ? glow_width : scene.tail_width);
-  for (; (it + 1) != links.end(); it++) {
-    // half-width of the tail
-    dx1 = dx2;
-    dx2 = ((*(it + 1)).glow ? glow_width : scene.tail_width);
-
-    // have the wind stretch the tail (greater effect on ends)
-    double age = (*it).age / scene.tail_length;
-    double stretch = stretch_factor * age * age;
-    double alpha = 0.9 - age;
-    if (alpha > scene.tail_opaq)
-      alpha = scene.tail_opaq;
+#include <string.h>
+
+void TailPool::init(unsigned n, unsigned count) {
+  block = n;
+  links.clear();
+  tails.clear();
+  gens.clear();
+  free_slots.clear();
+  links.reserve((size_t)n * count);
+  tails.reserve(count);
+  gens.reserve(count);
+}
 
-    // two rectangles: outer vertices have alpha=0, inner two have
-    // alpha based on age. note: alpha goes negative, but opengl
-    // should clamp it to 0.
-    if (stretch > 0) {  // stretch to the right
-      glBegin(GL_QUAD_STRIP);
-      DO_POINT(*it, -dx1, 0);
-      DO_POINT(*(it + 1), -dx2, 0);
+TailHandle TailPool::alloc() {
+  TailHandle h;
+  if (!free_slots.empty()) {
+    h.slot = free_slots.back();
+    free_slots.pop_back();
+  } else {
+    h.slot = tails.size();
+    tails.push_back(Tail());
+    tails.back().base = links.size();
+    gens.push_back(0);
+    links.resize(links.size() + block);
+  }
+  h.gen = gens[h.slot];
 
-      DO_POINT(*it, 0, alpha);
-      DO_POINT(*(it + 1), 0, alpha);
+  Tail& tail = tails[h.slot];
+  tail.head = 0;
+  tail.count = 0;
+  tail.attached = true;
+  return h;
+}
 
-      DO_POINT(*it, dx1 + stretch, 0);
-      DO_POINT(*(it + 1), dx2 + stretch, 0);
-    } else {  // stretch to the left
-      glBegin(GL_QUAD_STRIP);
-      DO_POINT(*it, -dx1 + stretch, 0);
-      DO_POINT(*(it + 1), -dx2 + stretch, 0);
+void TailPool::free(TailHandle h) {
+  gens[h.slot]++;
+  free_slots.push_back(h.slot);
+}
 
-      DO_POINT(*it, 0, alpha);
-      DO_POINT(*(it + 1), 0, alpha);
+Tail* TailPool::find(TailHandle h) {
+  if (h.slot >= tails.size() || gens[h.slot] != h.gen)
+    return 0;
+  return &tails[h.slot];
+}
 
-      DO_POINT(*it, dx1, 0);
-      DO_POINT(*(it + 1), dx2, 0);
-    }
-    glEnd();
-  }
+TailLink& Tail::link(unsigned i) {
+  unsigned cap = scene.tails.capacity();
+  return scene.tails.links[base + (head + cap - i) % cap];
 }
 
 bool Tail::elapse(double t) {
-  // pop off the dead ones.
-  // note we only have to check the end, since that's where they're gonna
-  // be dying from.  deque is very nice for this, because it has constant
-  // time  insertion/removal from both ends.
-  while (!links.empty() && links.back().age >= scene.tail_length)
-    links.pop_back();
-
-  deque<Link>::iterator it = links.begin();
-  for (; it != links.end(); it++) {
-    (*it).age += t;
-    double age = (*it).age / scene.tail_length;
-    (*it).pos += scene.wind * age * age;
-  }
-
-  if (owner == 0)          // my owner died! grow no longer
-    return links.empty();  // if we're empty, tell caller we're dead
-
-  links.push_front(Link(owner->pos, owner->color, owner->bait->glow));
+  // pop off the dead ones: anything that was already tail_length old last
+  // step. note we only have to check the end, since that's where they're
+  // gonna be dying from.
+  double then = scene.curtime - t;
+  while (count > 0 &&
+         then - scene.wind_time(link(count - 1).step) >= scene.tail_length)
+    count--;
+
+  // if my owner died and we're empty, tell caller we're dead
+  return !attached && count == 0;
+}
 
-  return false;
+void Tail::add_link(const Vec3f& pos, uint32_t rgba, bool glow) {
+  unsigned cap = scene.tails.capacity();
+  head = scene.step % cap;
+  if (count < cap)
+    count++;
+
+  TailLink& l = link(0);
+  l.pos = pos;
+  memcpy(l.color, &rgba, sizeof(l.color));
+  l.step = (uint32_t)scene.step;
+  l.glow = glow;
 }
@@ -4,34 +4,94 @@
 #include "main.h"
 #include "utils.h"
 #include <gfx/vec3.h>
-#include <deque>
+#include <vector>
 
-class Firefly;
+// a link never moves on its own: the wind blows it away from where it
+// was born, and the scene works out how far when we draw.
+struct TailLink {
+  Vec3f pos;                // position this link was born at
+  unsigned char color[4];   // RGBA8 color
+  uint32_t step;            // scene step this link was born in (low 32 bits)
+  bool glow;                // glow = wider size and higher alpha
+};
 
+// a tail is a ring buffer of links in its TailPool. when the ring is full
+// the oldest link is dropped to make room.
 class Tail {
-  struct Link {
-    Vec3f pos;       // position of this link
-    rgbColor color;  // color
-    double age;      // how long this link has existed (in seconds)
-    bool glow;       // glow = wider size and higher alpha
-    Link(Vec3f _pos, rgbColor _color, bool _glow)
-        : pos(_pos), color(_color), age(0), glow(_glow) {}
-  };
-  deque<Link> links;
+  friend class TailPool;
+
+  unsigned base;   // first link of my block in the pool
+  unsigned head;   // ring index of the newest link: the step it was born
+                   // in, mod the capacity, so every attached tail's newest
+                   // link is in the same place
+  unsigned count;  // number of links
 
  public:
-  Firefly* owner;  // the firefly I'm attached to
+  bool attached;  // false once the firefly I'm attached to has died
 
-  // Tail(
-  //	the firefly we're attached to)
-  Tail(Firefly* _owner);
-  virtual ~Tail() {}
+  unsigned size() const { return count; }
+  // ring index of link 0 (see TailPool::ring)
+  unsigned newest() const { return head; }
+  // link i, counting back from the newest (0) to the oldest (size()-1)
+  TailLink& link(unsigned i);
 
-  // draw the tail
-  // returns: true if we're a dead tail, false otherwise
-  virtual void draw();
   // let t seconds elapse
-  virtual bool elapse(double t);
+  // returns: true if we're a dead tail, false otherwise
+  bool elapse(double t);
+  // grow a new link at the head of the tail
+  void add_link(const Vec3f& pos, uint32_t rgba, bool glow);
+};
+
+// names a tail in a TailPool. slots are reused, so the handle also carries
+// the slot's generation: a handle kept past its tail's death won't find
+// the next tail to live there.
+struct TailHandle {
+  uint32_t slot;
+  uint32_t gen;
+
+  bool operator==(const TailHandle& h) const {
+    return slot == h.slot && gen == h.gen;
+  }
+  bool operator!=(const TailHandle& h) const { return !(*this == h); }
+};
+
+// every tail, and their links in fixed-size blocks carved out of one
+// array. a dead tail's slot goes on a free list for the next one, so once
+// the scene reaches its peak population, births and deaths don't touch
+// the heap.
+class TailPool {
+ public:
+  vector<TailLink> links;
+
+  TailPool() : block(0) {}
+
+  // make tails hold 'n' links, and room for 'tails' of them up front.
+  // only call while no tails exist.
+  void init(unsigned n, unsigned tails);
+  // links per tail
+  unsigned capacity() const { return block; }
+  // slots there are links for, whether their tails are alive or not
+  unsigned slots() const { return tails.size(); }
+  // slot 'slot's link at ring index i
+  const TailLink& ring(unsigned slot, unsigned i) const {
+    return links[(size_t)slot * block + i];
+  }
+
+  // returns: a new, empty, attached tail
+  TailHandle alloc();
+  // kill tail 'h': its slot goes to the next alloc()
+  void free(TailHandle h);
+  // returns: tail 'h', or 0 if it has died
+  Tail* find(TailHandle h);
+
+  // tail 'h', which must be alive
+  Tail& operator[](TailHandle h) { return tails[h.slot]; }
+
+ private:
+  unsigned block;
+  vector<Tail> tails;
+  vector<uint32_t> gens;  // the generation of each slot's tail
+  vector<uint32_t> free_slots;
 };
 
 #endif  // tail.h
@@ -0,0 +1,111 @@
+#include "tailmesh.h"
+
+void TailMesh::plan(Scene& s) {
+  nverts = nindex = 0;
+  tails.clear();
+  vert_first.clear();
+  index_first.clear();
+  strip_first.clear();
+  strip_count.clear();
+
+  for (unsigned i = 0; i < s.flies.size(); i++)
+    plan_tail(s.tails[s.flies.tail[i]]);
+
+  for (unsigned i = 0; i < s.dead_tails.size(); i++)
+    plan_tail(s.tails[s.dead_tails[i]]);
+}
+
+void TailMesh::plan_tail(Tail& tail) {
+  unsigned n = tail.size();
+  if (n < 2)  // need at least 2 links
+    return;
+
+  tails.push_back(&tail);
+  vert_first.push_back(nverts);
+  index_first.push_back(nindex);
+  nverts += 3 * n;
+  // the left half, then the right
+  for (unsigned half = 0; half < 2; half++) {
+    strip_first.push_back(nindex);
+    strip_count.push_back(2 * n);
+    nindex += 2 * n + 1;
+  }
+}
+
+// tails per chunk when meshing in parallel
+#define MESH_GRAIN 256
+
+void TailMesh::fill(Scene& s, TailVertex* verts, uint32_t* index) {
+  TRACE_SCOPE("mesh tails");
+  // worked out once per step, so do it before the threads all want it
+  const vector<Vec3f>& offsets = s.wind_offsets();
+  s.workers.run(tails.size(), MESH_GRAIN,
+                [&](unsigned begin, unsigned end) {
+                  fill_range(s, offsets, verts, index, begin, end);
+                });
+}
+
+void TailMesh::fill_range(Scene& s, const vector<Vec3f>& offsets,
+                          TailVertex* verts, uint32_t* index, unsigned begin,
+                          unsigned end) {
+  TRACE_SCOPE("tail mesh chunk");
+  for (unsigned t = begin; t < end; t++) {
+    fill_tail(s, offsets, *tails[t], vert_first[t], verts + vert_first[t],
+              index + index_first[t]);
+  }
+}
+
+void TailMesh::fill_tail(Scene& s, const vector<Vec3f>& offsets, Tail& tail,
+                         uint32_t first, TailVertex* verts, uint32_t* index) {
+  unsigned n = tail.size();
+  double glow_width = s.glow_factor * s.tail_width;
+  double stretch_factor = 2 * s.fsize * s.wind[0];
+
+  for (unsigned k = 0; k < n; k++) {
+    const TailLink& l = tail.link(k);
+
+    // where the wind has blown it, and its half-width
+    unsigned w = s.wind_index(l.step);
+    Vec3f p = l.pos + offsets[w];
+    double dx = (l.glow ? glow_width : s.tail_width);
+
+    // have the wind stretch the tail (greater effect on ends), to the
+    // right or the left
+    double age = s.wind_age(w) / s.tail_length;
+    double stretch = stretch_factor * age * age;
+    double left = -dx + (stretch < 0 ? stretch : 0);
+    double right = dx + (stretch > 0 ? stretch : 0);
+
+    // the edges are clear, and the middle fades with age
+    double alpha = 0.9 - age;
+    if (alpha > s.tail_opaq)
+      alpha = s.tail_opaq;
+    unsigned char a = (alpha <= 0) ? 0 : (unsigned char)(alpha * 255 + 0.5);
+
+    TailVertex v;
+    v.pos[1] = p[1];
+    v.pos[2] = p[2];
+    unsigned char* c = (unsigned char*)&v.rgba;
+    c[0] = l.color[0];
+    c[1] = l.color[1];
+    c[2] = l.color[2];
+
+    c[3] = 0;
+    v.pos[0] = p[0] + left;
+    *verts++ = v;
+    c[3] = a;
+    v.pos[0] = p[0];
+    *verts++ = v;
+    c[3] = 0;
+    v.pos[0] = p[0] + right;
+    *verts++ = v;
+  }
+
+  for (unsigned half = 0; half < 2; half++) {
+    for (unsigned k = 0; k < n; k++) {
+      *index++ = first + 3 * k + half;
+      *index++ = first + 3 * k + half + 1;
+    }
+    *index++ = TAIL_RESTART;
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef _TAILMESH_H
+#define _TAILMESH_H
+
+#include "main.h"
+#include "scene.h"
+
+#include <stdint.h>
+#include <vector>
+
+// ends one triangle strip in TailMesh::index (the primitive restart index)
+#define TAIL_RESTART 0xffffffffu
+
+// one corner of a tail's mesh, ready to go straight into a vertex buffer
+struct TailVertex {
+  float pos[3];
+  uint32_t rgba;  // RGBA8
+};
+
+// the triangles for every tail in the scene, in one vertex array. each
+// link of a tail has three vertices across it: the two edges, which are
+// clear, and the middle. a tail is then two triangle strips, one down
+// each half, which share the vertices of each link with the segments on
+// either side of it.
+//
+// plan() works out how big the mesh is, so the caller can find room for
+// it (say, in a mapped vertex buffer), and where in there each tail goes.
+// fill() then writes the tails on the scene's worker threads, each into
+// its own part of the mesh, so there's no locking.
+class TailMesh {
+ public:
+  unsigned nverts;  // vertices in the mesh planned
+  unsigned nindex;  // indices in its strips, each ended by TAIL_RESTART
+
+  // where each strip is in the index and how long it is (less the
+  // TAIL_RESTART), for drawing without primitive restart
+  vector<uint32_t> strip_first;
+  vector<uint32_t> strip_count;
+
+  TailMesh() : nverts(0), nindex(0) {}
+
+  // plan the mesh of scene s's flies' tails, and its dead tails
+  void plan(Scene& s);
+  // write the planned mesh to 'verts' and 'index'
+  void fill(Scene& s, TailVertex* verts, uint32_t* index);
+
+ private:
+  vector<Tail*> tails;  // the tails to mesh
+  // where each tail's vertices and indices start: the running totals of
+  // the ones before it
+  vector<uint32_t> vert_first;
+  vector<uint32_t> index_first;
+
+  void plan_tail(Tail& tail);
+  // mesh tails [begin, end)
+  void fill_range(Scene& s, const vector<Vec3f>& offsets, TailVertex* verts,
+                  uint32_t* index, unsigned begin, unsigned end);
+  // mesh a tail into 'verts', which is vertex 'first' of the mesh, and
+  // 'index'
+  void fill_tail(Scene& s, const vector<Vec3f>& offsets, Tail& tail,
+                 uint32_t first, TailVertex* verts, uint32_t* index);
+};
+
+#endif  // _TAILMESH_H
@@ -0,0 +1,180 @@
+#include "trace.h"
+#include "main.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <fstream>
+#include <stdio.h>
+#include <signal.h>
+#include <vector>
+
+// one zone. the fields are atomic since trace_dump() can read a slot
+// while its thread overwrites it; it throws those ones away.
+struct TraceEvent {
+  std::atomic<const char*> name;
+  std::atomic<uint64_t> start;
+  std::atomic<uint64_t> end;
+};
+
+struct TraceRing {
+  TraceEvent events[TRACE_RING_SIZE];
+  std::atomic<uint64_t> head;  // number of zones ever written
+  std::atomic<const char*> name;
+  std::atomic<bool> owned;  // does a living thread write to this?
+  unsigned tid;
+};
+
+static std::mutex rings_lock;  // guards 'rings' (not what's in them)
+static vector<TraceRing*> rings;
+
+static volatile sig_atomic_t dump_requested = 0;
+
+// find this thread a ring: one a finished thread left behind, or a new one
+static TraceRing* claim_ring() {
+  std::lock_guard<std::mutex> guard(rings_lock);
+  for (unsigned i = 0; i < rings.size(); i++) {
+    if (!rings[i]->owned) {
+      rings[i]->owned = true;
+      rings[i]->name = 0;
+      return rings[i];
+    }
+  }
+
+  TraceRing* ring = new TraceRing();
+  ring->head = 0;
+  ring->name = 0;
+  ring->owned = true;
+  ring->tid = rings.size() + 1;
+  rings.push_back(ring);
+  return ring;
+}
+
+// hands the ring back when the thread exits
+struct RingOwner {
+  TraceRing* ring;
+  RingOwner() : ring(claim_ring()) {}
+  ~RingOwner() { ring->owned = false; }
+};
+
+static thread_local RingOwner owner;
+
+uint64_t trace_now() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void trace_zone(const char* name, uint64_t start, uint64_t end) {
+  TraceRing* ring = owner.ring;
+  uint64_t h = ring->head.load(std::memory_order_relaxed);
+  TraceEvent& e = ring->events[h % TRACE_RING_SIZE];
+  e.name.store(name, std::memory_order_relaxed);
+  e.start.store(start, std::memory_order_relaxed);
+  e.end.store(end, std::memory_order_relaxed);
+  ring->head.store(h + 1, std::memory_order_release);
+}
+
+void trace_thread_name(const char* name) {
+  owner.ring->name = name;
+}
+
+// write a string as JSON, escaping what needs it
+static void write_string(ostream& out, const char* s) {
+  out << '"';
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      out << '\\' << *s;
+    else if ((unsigned char)*s < 0x20)
+      out << ' ';
+    else
+      out << *s;
+  }
+  out << '"';
+}
+
+bool trace_dump(const char* filename) {
+  std::ofstream out(filename);
+  if (!out)
+    return false;
+
+  vector<TraceRing*> all;
+  {
+    std::lock_guard<std::mutex> guard(rings_lock);
+    all = rings;
+  }
+
+  char buf[64];
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl;
+  out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+         "\"args\": {\"name\": \"fireflies\"}}";
+  for (unsigned r = 0; r < all.size(); r++) {
+    TraceRing* ring = all[r];
+
+    const char* name = ring->name;
+    snprintf(buf, sizeof(buf), "thread %u", ring->tid);
+    out << "," << endl
+        << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+        << "\"tid\": " << ring->tid << ", \"args\": {\"name\": ";
+    write_string(out, name ? name : buf);
+    out << "}}";
+
+    // copy out the ring, then see how far its thread got in the meantime.
+    // slots it may have been writing to hold garbage, so skip those.
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t begin = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    vector<const char*> names;
+    vector<uint64_t> starts, ends;
+    for (uint64_t i = begin; i < head; i++) {
+      TraceEvent& e = ring->events[i % TRACE_RING_SIZE];
+      names.push_back(e.name.load(std::memory_order_relaxed));
+      starts.push_back(e.start.load(std::memory_order_relaxed));
+      ends.push_back(e.end.load(std::memory_order_relaxed));
+    }
+    uint64_t now = ring->head.load(std::memory_order_acquire);
+    uint64_t valid = now + 1 > TRACE_RING_SIZE ? now + 1 - TRACE_RING_SIZE : 0;
+
+    for (uint64_t i = begin; i < head; i++) {
+      if (i < valid)
+        continue;
+      unsigned k = i - begin;
+      out << "," << endl << "{\"name\": ";
+      write_string(out, names[k]);
+      // chrome wants microseconds
+      snprintf(buf, sizeof(buf), "%.3f, \"dur\": %.3f", starts[k] / 1000.0,
+               (ends[k] - starts[k]) / 1000.0);
+      out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << ring->tid
+          << ", \"ts\": " << buf << "}";
+    }
+  }
+  out << endl << "]}" << endl;
+
+  return (bool)out;
+}
+
+void trace_request_dump() {
+  dump_requested = 1;
+}
+
+bool trace_dump_requested() {
+  if (!dump_requested)
+    return false;
+  dump_requested = 0;
+  return true;
+}
+
+#ifndef WIN32
+static void on_signal(int) {
+  trace_request_dump();
+}
+#endif
+
+void trace_catch_signal() {
+#ifndef WIN32
+  struct sigaction sa;
+  sa.sa_handler = on_signal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &sa, 0);
+#endif
+}
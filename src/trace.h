@@ -0,0 +1,54 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdint.h>
+
+// a record of where the time goes, cheap enough to leave on all the time.
+// each thread writes the zones it leaves into its own ring of the last
+// TRACE_RING_SIZE, with no locking, and trace_dump() writes all the
+// rings out in the chrome://tracing (or Perfetto) JSON format.
+//
+//   void Scene::elapse_baits(double t) {
+//     TRACE_SCOPE("baits");
+//     ...
+//   }
+//
+// zone names must be string literals (or otherwise live forever), since
+// only the pointer is kept.
+
+#define TRACE_RING_SIZE 16384
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+// time the rest of the enclosing block as zone 'name'
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(_trace_, __LINE__)(name)
+
+// nanoseconds on a clock that only goes forward
+uint64_t trace_now();
+// record a zone that ran from 'start' to 'end' on this thread
+void trace_zone(const char* name, uint64_t start, uint64_t end);
+// name this thread in the trace (the name must live forever, like zones)
+void trace_thread_name(const char* name);
+
+// write every thread's ring to 'filename'. returns false if it can't.
+// the threads can keep on tracing while this runs.
+bool trace_dump(const char* filename);
+
+// ask for a dump from somewhere that can't do one, like a signal
+// handler. the main loop picks it up with trace_dump_requested().
+void trace_request_dump();
+// true (once) if a dump has been asked for since the last call
+bool trace_dump_requested();
+// have SIGUSR1 ask for a dump (does nothing on Windows)
+void trace_catch_signal();
+
+class TraceScope {
+  const char* name;
+  uint64_t start;
+
+ public:
+  explicit TraceScope(const char* _name) : name(_name), start(trace_now()) {}
+  ~TraceScope() { trace_zone(name, start, trace_now()); }
+};
+
+#endif  // _TRACE_H
@@ -59,86 +59,19 @@ hsvColor rgb_to_hsv(const rgbColor& rgb) {
 
 rgbColor hsv_to_rgb(const hsvColor& hsv) {
   rgbColor rgb;
-  float h = hsv[0] / 60, s = hsv[1], v = hsv[2];
-  float f, p, q, t;
-  int i;
+  float h6 = wrap_hue(hsv[0]) * (1.f / 60.f), v = hsv[2], vs = v * hsv[1];
 
+  rgb[0] = hsv_channel(5.f, h6, v, vs);
+  rgb[1] = hsv_channel(3.f, h6, v, vs);
+  rgb[2] = hsv_channel(1.f, h6, v, vs);
   rgb[3] = hsv[3];  // alpha value
-
-  if (FEQ(s, 0)) {
-    rgb[0] = rgb[1] = rgb[2] = v;
-    return rgb;
-  }
-
-  // don't ask me what this means.. I yoinked it from a website.
-  i = (int)floor(h);  // sectors 0 - 5
-  f = h - i;
-  p = v * (1 - s);
-  q = v * (1 - s * f);
-  t = v * (1 - s * (1 - f));
-
-  switch (i) {  // what sector?
-    case 0:
-      rgb[0] = v;
-      rgb[1] = t;
-      rgb[2] = p;
-      break;
-    case 1:
-      rgb[0] = q;
-      rgb[1] = v;
-      rgb[2] = p;
-      break;
-    case 2:
-      rgb[0] = p;
-      rgb[1] = v;
-      rgb[2] = t;
-      break;
-    case 3:
-      rgb[0] = p;
-      rgb[1] = q;
-      rgb[2] = v;
-      break;
-    case 4:
-      rgb[0] = t;
-      rgb[1] = p;
-      rgb[2] = v;
-      break;
-    default:
-      rgb[0] = v;
-      rgb[1] = p;
-      rgb[2] = q;
-      break;
-  }
   return rgb;
 }
 
-void Timer::add(int what, double when) {
-  deque<Event>::iterator it = events.begin();
-  while (it != events.end()) {
-    if (when < (*it).second)
-      break;
-    it++;
-  }
-  events.insert(it, Event(what, when));
-}
-
-bool Timer::is_ready(double now) {
-  return (!events.empty() && (now >= events[0].second));
-}
-
-void Timer::clear() {
-  events.clear();
-}
-
-int Timer::pop() {
-  int what = events[0].first;
-  events.pop_front();
-  return what;
-}
-
-void RandVar::add(int val, double prob) {
-  max_prob += prob;
-  events.push_back(Event(val, prob));
+void RandVar::add(int val, double p) {
+  max_prob += p;
+  events.push_back(Event(val, p));
+  built = false;
 }
 
 void RandVar::change(int val, double newprob) {
@@ -146,6 +79,7 @@ void RandVar::change(int val, double newprob) {
     if (events[i].first == val) {
       max_prob += (newprob - events[i].second);
       events[i].second = newprob;
+      built = false;
 #ifdef DEBUG
       cerr << val << " changed to " << newprob << " out of " << max_prob
            << endl;
@@ -160,15 +94,75 @@ void RandVar::change(int val, double newprob) {
 void RandVar::clear() {
   events.clear();
   max_prob = 0.0;
+  built = false;
 }
 
 int RandVar::rand() {
-  double r = rand_real(0., max_prob);
-  double prob = 0.;
-  for (size_t i = 0; i < events.size(); i++) {
-    prob += events[i].second;
-    if (r < prob)
-      return events[i].first;
+  return rand(scene_rng());
+}
+
+int RandVar::rand(Rng& rng) {
+  if (!built)
+    build();
+  if (max_prob <= 0.)
+    return -1;
+  return pick(rng.real());
+}
+
+void RandVar::rand_n(int* out, unsigned n) {
+  rand_n(scene_rng(), out, n);
+}
+
+void RandVar::rand_n(Rng& rng, int* out, unsigned n) {
+  if (!built)
+    build();
+  for (unsigned i = 0; i < n; i++)
+    out[i] = (max_prob > 0.) ? pick(rng.real()) : -1;
+}
+
+void RandVar::build() {
+  unsigned n = events.size();
+  prob.resize(n);
+  alias.resize(n);
+  built = true;
+  if (max_prob <= 0.)
+    return;
+
+  // scale the weights so they average 1, then split them into columns
+  // under 1 and over 1. each short column is topped up from a tall one.
+  vector<unsigned> small, large;
+  for (unsigned i = 0; i < n; i++) {
+    prob[i] = events[i].second * n / max_prob;
+    alias[i] = i;
+    if (prob[i] < 1.)
+      small.push_back(i);
+    else
+      large.push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    unsigned s = small.back(), l = large.back();
+    small.pop_back();
+    alias[s] = l;
+    prob[l] -= 1. - prob[s];
+    if (prob[l] < 1.) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // whatever's left is 1, give or take rounding. but never let rounding
+  // make a value with no weight possible: send its column to one with.
+  unsigned some = 0;
+  while (events[some].second <= 0.)
+    some++;
+  for (unsigned i = 0; i < large.size(); i++)
+    prob[large[i]] = 1.;
+  for (unsigned i = 0; i < small.size(); i++) {
+    unsigned s = small[i];
+    if (events[s].second > 0.) {
+      prob[s] = 1.;
+    } else {
+      prob[s] = 0.;
+      alias[s] = some;
+    }
   }
-  return -1;  // should never happen
 }
@@ -2,8 +2,8 @@
 #define _UTILS_H
 
 #include "main.h"
+#include "rng.h"
 #include <gfx/mat4.h>
-#include <deque>
 #include <vector>
 #include <utility>
 
@@ -19,17 +19,31 @@ typedef Vec4f hsvColor;
 void clamp_vec(Vec3f& vec, double max);
 
 // return a random number between lo and hi inclusive
+inline int rand_int(Rng& rng, int lo, int hi) {
+  return lo + (int)((hi - lo + 1) * rng.real());
+}
+
+inline double rand_real(Rng& rng, double lo, double hi) {
+  return lo + (hi - lo) * rng.real();
+}
+
+inline Vec3f rand_vec3(Rng& rng, double lo, double hi) {
+  return Vec3f(rand_real(rng, lo, hi), rand_real(rng, lo, hi),
+               rand_real(rng, lo, hi));
+}
+
+// the same, drawing from the scene-wide stream. only call these from the
+// main thread; anything elapsed in parallel uses its own Rng::stream().
 inline int rand_int(int lo, int hi) {
-  return lo +
-         (int)((hi - lo + 1) * ((double)rand() / (double)(RAND_MAX + 1.0)));
+  return rand_int(scene_rng(), lo, hi);
 }
 
 inline double rand_real(double lo, double hi) {
-  return lo + (hi - lo) * ((double)rand() / (double)(RAND_MAX + 1.0));
+  return rand_real(scene_rng(), lo, hi);
 }
 
 inline Vec3f rand_vec3(double lo, double hi) {
-  return Vec3f(rand_real(lo, hi), rand_real(lo, hi), rand_real(lo, hi));
+  return rand_vec3(scene_rng(), lo, hi);
 }
 
 // return a random int other than 'other'
@@ -41,37 +55,49 @@ inline Vec3f unit_vec(const Vec3f& v) {
   return (n == 0) ? v : v / n;
 }
 
+// pack a color with [0,1] components into RGBA8 bytes
+inline void pack_rgba(const rgbColor& c, unsigned char* out) {
+  for (int i = 0; i < 4; i++) {
+    float v = c[i] * 255.f + 0.5f;
+    out[i] = (v <= 0.f) ? 0 : (v >= 255.f) ? 255 : (unsigned char)v;
+  }
+}
+
+// unpack RGBA8 bytes into a color with [0,1] components
+inline rgbColor unpack_rgba(const unsigned char* in) {
+  return rgbColor(in[0] / 255.f, in[1] / 255.f, in[2] / 255.f, in[3] / 255.f);
+}
+
+// wrap a hue in degrees into [0,360), without looping
+inline float wrap_hue(float h) {
+  return h - 360.f * floorf(h * (1.f / 360.f));
+}
+
+// one channel of hsv_to_rgb(): n is 5 for red, 3 for green and 1 for
+// blue, h6 the hue in sixths of a turn, and vs = v * s. each channel is
+// v, less v * s where the hue is more than 60 degrees from that channel's
+// color, ramping linearly in between. this needs no sector switch, so
+// color_kernel() does the same thing with SIMD.
+static inline float hsv_channel(float n, float h6, float v, float vs) {
+  float k = n + h6;
+  if (k >= 6.f)
+    k -= 6.f;
+  float w = fmaxf(fminf(fminf(k, 4.f - k), 1.f), 0.f);
+  return v - vs * w;
+}
+
 // color space conversion
 hsvColor rgb_to_hsv(const rgbColor& rgb);
 rgbColor hsv_to_rgb(const hsvColor& hsv);
 
-// a set of events and the time for them to occur
-class Timer {
- public:
-  typedef pair<int, double> Event;
-  deque<Event> events;
-
-  Timer() {}
-  // add an event that needs to be done at time 'when'
-  void add(int what, double when);
-  // checks if an event is ready, ie the current time (now) is past one
-  // of the times for an event.
-  bool is_ready(double now);
-  // clears all events
-  void clear();
-  // return the earliest-to-occur event. note: this (obviously) does not
-  // check that the current time is past the event's time.
-  int pop();
-};
-
 // a random variable which takes on a given value with a given probability
 class RandVar {
  public:
   typedef pair<int, double> Event;
-  vector<Event> events;
+  vector<Event> events;  // only change these through add() and change()
   double max_prob;  // the sum of probabilities of all events
 
-  RandVar() : max_prob(0.0) {}
+  RandVar() : max_prob(0.0), built(false) {}
 
   // add a value and it's probability weight to the set
   void add(int val, double prob);
@@ -82,8 +108,28 @@ class RandVar {
   void clear();
   // return one of the values based on the weighted probability of each
   // value. for example, if value '0' has probability 0.9, it will be
-  // returned 90% of the time.
+  // returned 90% of the time. returns -1 if every weight is 0.
   int rand();
+  int rand(Rng& rng);
+  // fill out[0..n) with independent draws
+  void rand_n(int* out, unsigned n);
+  void rand_n(Rng& rng, int* out, unsigned n);
+
+ private:
+  // a Walker alias table, rebuilt on the first draw after a change: event
+  // i is drawn with chance prob[i] / n, and otherwise its column goes to
+  // event alias[i]. a draw is one random number and no search.
+  vector<double> prob;
+  vector<unsigned> alias;
+  bool built;
+
+  void build();
+  // the draw for a random number r in [0, 1)
+  int pick(double r) const {
+    double u = r * events.size();
+    unsigned i = (unsigned)u;
+    return events[(u - i < prob[i]) ? i : alias[i]].first;
+  }
 };
 
 #endif  // _UTILS_H
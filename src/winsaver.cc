@@ -1,5 +1,6 @@
 #include "main.h"
 #include "scene.h"
+#include "renderer.h"
 #include "modes.h"
 
 #include <GL/gl.h>
@@ -20,10 +21,12 @@
 double fps = 20;
 
 Scene scene;
+StreamBuffer stream;
+Renderer renderer(&scene, &stream);
 
 static struct timeb then;
 
-void init_gl(HWND hWnd, HDC& hDC, HGLRC& hRC) {
+bool init_gl(HWND hWnd, HDC& hDC, HGLRC& hRC) {
   PIXELFORMATDESCRIPTOR pfd;
   ZeroMemory(&pfd, sizeof pfd);
   pfd.nSize = sizeof pfd;
@@ -40,6 +43,14 @@ void init_gl(HWND hWnd, HDC& hDC, HGLRC& hRC) {
 
   hRC = wglCreateContext(hDC);
   wglMakeCurrent(hDC, hRC);
+
+  // the tails and arrows are drawn from buffer objects, through GLEW
+  GLenum err = glewInit();
+  if (err != GLEW_OK) {
+    cerr << "Error initializing: " << glewGetErrorString(err) << endl;
+    return false;
+  }
+  return true;
 }
 
 // Shut down OpenGL
@@ -53,7 +64,7 @@ void close_gl(HWND hWnd, HDC hDC, HGLRC hRC) {
 void start_animate(int width, int height) {
   glViewport(0, 0, width, height);
 
-  scene.resize(width, height);
+  renderer.resize(width, height);
   scene.create();
 
   ftime(&then);
@@ -69,8 +80,8 @@ void on_timer(HDC hDC)  // increment and display
              double((now.millitm - then.millitm) / 1000.0);
   then = now;
   scene.elapse(t);
-  scene.apply_camera();
-  scene.draw();
+  renderer.apply_camera(Vec3(0, 0, 0));
+  renderer.draw();
 
   glFinish();
   SwapBuffers(hDC);
@@ -287,7 +298,7 @@ LRESULT WINAPI ScreenSaverProc(HWND hWnd,
   static RECT rect;
   int width, height;
 
-  srand(time(0));
+  scene.seed = time(0);
   switch (message) {
     case WM_CREATE:
       GetClientRect(hWnd, &rect);
@@ -296,7 +307,8 @@ LRESULT WINAPI ScreenSaverProc(HWND hWnd,
 
       read_config();
 
-      init_gl(hWnd, hDC, hRC);
+      if (!init_gl(hWnd, hDC, hRC))
+        return -1;  // don't create the window
       start_animate(width, height);
 
       // tick every 1000/fps ms
@@ -0,0 +1,93 @@
+#include "workers.h"
+#include "trace.h"
+
+WorkerPool::WorkerPool()
+    : generation(0), busy(0), quitting(false), job(0), job_size(0),
+      chunk_size(1), next_chunk(0) {}
+
+WorkerPool::~WorkerPool() {
+  stop();
+}
+
+void WorkerPool::start(unsigned n) {
+  stop();
+  if (n == 0)
+    n = std::thread::hardware_concurrency();
+
+  quitting = false;
+  for (unsigned i = 1; i < n; i++)
+    workers.push_back(std::thread(&WorkerPool::work, this, generation));
+}
+
+void WorkerPool::stop() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    quitting = true;
+  }
+  wake.notify_all();
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+  workers.clear();
+}
+
+void WorkerPool::run(unsigned n, unsigned grain, const Job& j) {
+  if (n == 0)
+    return;
+
+  // a few chunks per thread evens out the load when chunks differ in cost
+  unsigned chunk = n / (4 * size());
+  if (chunk < grain)
+    chunk = grain;
+  if (workers.empty() || chunk >= n) {
+    j(0, n);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    job = &j;
+    job_size = n;
+    chunk_size = chunk;
+    next_chunk = 0;
+    busy = workers.size();
+    generation++;
+  }
+  wake.notify_all();
+
+  do_chunks();
+
+  std::unique_lock<std::mutex> guard(lock);
+  while (busy > 0)
+    done.wait(guard);
+  job = 0;
+}
+
+void WorkerPool::work(unsigned seen) {
+  trace_thread_name("worker");
+  std::unique_lock<std::mutex> guard(lock);
+
+  while (true) {
+    while (!quitting && generation == seen)
+      wake.wait(guard);
+    if (quitting)
+      return;
+    seen = generation;
+
+    guard.unlock();
+    do_chunks();
+    guard.lock();
+
+    if (--busy == 0)
+      done.notify_one();
+  }
+}
+
+void WorkerPool::do_chunks() {
+  unsigned begin;
+  while ((begin = chunk_size * next_chunk++) < job_size) {
+    unsigned end = begin + chunk_size;
+    if (end > job_size)
+      end = job_size;
+    (*job)(begin, end);
+  }
+}
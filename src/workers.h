@@ -0,0 +1,56 @@
+#ifndef _WORKERS_H
+#define _WORKERS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed set of worker threads that split a range of work into chunks.
+// the calling thread works on chunks too, so a pool of size 1 has no
+// workers at all and just runs everything inline.
+class WorkerPool {
+ public:
+  typedef std::function<void(unsigned, unsigned)> Job;
+
+  WorkerPool();
+  ~WorkerPool();
+
+  // (re)start the pool with 'n' threads, counting the caller. 0 means one
+  // per CPU.
+  void start(unsigned n);
+  // stop and join all the worker threads
+  void stop();
+  // number of threads working on each run(), counting the caller
+  unsigned size() const { return workers.size() + 1; }
+
+  // call job(begin, end) on disjoint chunks covering [0, n), each at least
+  // 'grain' long, and wait until they are all done.
+  void run(unsigned n, unsigned grain, const Job& job);
+
+ private:
+  std::vector<std::thread> workers;
+  std::mutex lock;
+  std::condition_variable wake;  // signals a new job (or quitting)
+  std::condition_variable done;  // signals all workers are finished
+  unsigned generation;           // bumped for every job
+  unsigned busy;                 // workers still working on this job
+  bool quitting;
+
+  // the current job
+  const Job* job;
+  unsigned job_size;
+  unsigned chunk_size;
+  std::atomic<unsigned> next_chunk;
+
+  // worker thread main loop. 'seen' is the last job generation it skips.
+  void work(unsigned seen);
+  void do_chunks();
+
+  WorkerPool(const WorkerPool&);
+  WorkerPool& operator=(const WorkerPool&);
+};
+
+#endif  // _WORKERS_H